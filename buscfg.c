@@ -0,0 +1,91 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "hal.h"
+#include "snes2ps.h"
+#include "config.h"
+#include "buscfg.h"
+
+volatile struct buscfg g_buscfg;
+
+/* The committed image is applied, BUSCFG_BUSY until it is saved */
+static unsigned char saving;
+
+void buscfg_init(void)
+{
+	memcpy((void*)&g_buscfg.image.cfg, &g_cfg, sizeof(g_cfg));
+	g_buscfg.editing = 0;
+	g_buscfg.status = BUSCFG_IDLE;
+	saving = 0;
+}
+
+/* Copy g_cfg to the image when it changed, unless a write is in
+ * progress. */
+static void refresh(void)
+{
+	void *image = (void *)&g_buscfg.image.cfg;
+
+	if (g_buscfg.editing || !memcmp(image, &g_cfg, sizeof(g_cfg)))
+		return;
+
+	// Not in the middle of a read
+	config_lock();
+	if (!g_buscfg.editing)
+		memcpy(image, &g_cfg, sizeof(g_cfg));
+	config_unlock();
+}
+
+void buscfg_poll(void)
+{
+	struct adapter_config *cfg = (struct adapter_config *)&g_buscfg.image.cfg;
+	unsigned char sum = 0;
+	unsigned char i;
+
+	if (g_buscfg.status != BUSCFG_BUSY) {
+		refresh();
+		return;
+	}
+
+	// One byte per pass, see config_poll()
+	if (saving) {
+		if (!config_saving()) {
+			saving = 0;
+			g_buscfg.status = BUSCFG_OK;
+		}
+		return;
+	}
+
+	if (CHIP_SELECT_ACTIVE())
+		return;
+
+	// Writes are ignored while busy, so the image is stable.
+	for (i=0; i<BUSCFG_IMAGE_SIZE; i++)
+		sum += g_buscfg.image.raw[i];
+
+	// Either way, the image follows g_cfg again
+	g_buscfg.editing = 0;
+
+	if (sum != g_buscfg.sum || config_apply(cfg)) {
+		g_buscfg.status = BUSCFG_ERROR;
+		return;
+	}
+
+	config_save();
+	saving = 1;
+}
@@ -0,0 +1,83 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _buscfg_h__
+#define _buscfg_h__
+
+#include "config.h"
+
+/* Configuration through the controller port, for adapters without
+ * access to the USART. The console sends 0x70 instead of 0x42:
+ *
+ *  Console: 0x01, 0x70, op,   arg,    data...
+ *  Adapter: 0xFF, ID,   0x5a, status, reply...
+ *
+ * The image is a copy of struct adapter_config. It follows the live
+ * configuration (including changes from the console or profiles) until
+ * the first BUSCFG_OP_WRITE, then holds the written bytes until the
+ * commit is done.
+ *
+ * BUSCFG_OP_STATUS: arg ignored, reply is the image size.
+ * BUSCFG_OP_READ:   arg is an offset, replies are image bytes from there.
+ * BUSCFG_OP_WRITE:  arg is an offset, data is stored from there. Each reply
+ *                   echoes the previous data byte. Ignored while busy.
+ * BUSCFG_OP_COMMIT: arg is the 8 bit sum of the image. Once attention is
+ *                   deasserted, the image is checked and applied, then
+ *                   saved to EEPROM in the background (about 0.3s). Poll
+ *                   with BUSCFG_OP_STATUS for the result.
+ */
+#define CMD_VENDOR_CONFIG_70	0x70
+
+#define BUSCFG_OP_STATUS	0x00
+#define BUSCFG_OP_READ		0x01
+#define BUSCFG_OP_WRITE		0x02
+#define BUSCFG_OP_COMMIT	0x03
+
+#define BUSCFG_IDLE			0x00
+#define BUSCFG_BUSY			0x01 // Commit pending or being saved
+#define BUSCFG_OK			0x02 // Last commit applied and saved
+#define BUSCFG_ERROR		0x03 // Last commit rejected (bad sum or contents)
+
+#define BUSCFG_IMAGE_SIZE	sizeof(struct adapter_config)
+
+/* Accessed directly by the PSX interrupt handler. */
+struct buscfg {
+	unsigned char status;
+	unsigned char editing;	// Written since the last commit
+	unsigned char sum;
+	unsigned char pos;
+	union {
+		struct adapter_config cfg;
+		unsigned char raw[BUSCFG_IMAGE_SIZE];
+	} image;
+};
+
+extern volatile struct buscfg g_buscfg;
+
+#ifdef WITH_BUSCFG
+void buscfg_init(void);
+
+/* Call from the main loop, with config_poll(). Performs pending
+ * commits. */
+void buscfg_poll(void);
+#else
+#define buscfg_init()	do { } while(0)
+#define buscfg_poll()	do { } while(0)
+#endif
+
+#endif // _buscfg_h__
@@ -0,0 +1,341 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stddef.h>
+#include <string.h>
+#include "hal.h"
+#include "snes2ps.h"
+#include "config.h"
+
+/* Bump when struct adapter_config changes so old EEPROM contents
+ * are ignored instead of being misinterpreted. */
+#define CONFIG_MAGIC	0x5C02
+
+struct eeprom_config {
+	unsigned short magic;
+	struct adapter_config cfg;
+	unsigned char sum;
+};
+
+#define ee_config	(*(struct eeprom_config *)HAL_EEPROM(EE_CONFIG_ADDR))
+
+// Fails to compile if the config outgrows its area
+typedef char ee_config_fits[sizeof(struct eeprom_config) <= EE_CONFIG_SIZE ? 1 : -1];
+
+/* Next byte of a save or erase, see saveStep(). Nothing to do when
+ * save_pos is save_end. */
+static unsigned short save_pos, save_end;
+static unsigned char save_sum;
+#define SAVE_SUM	offsetof(struct eeprom_config, sum)
+#define SAVE_STEPS	(SAVE_SUM + 1 + sizeof(ee_config.magic))
+
+struct adapter_config g_cfg = {
+	.deviceID = DEVICE_ID_DIGITAL_PS1,
+	.ack_delay = DEFAULT_ACK_DELAY,
+	.ack_width = DEFAULT_ACK_WIDTH,
+};
+
+unsigned char g_map_serial;
+
+static const struct map_ent type1_mapping[] PROGMEM = {
+		{ SNES_B, 		PSX_X,        DS2_ANALOG_X },
+		{ SNES_Y, 		PSX_SQUARE,   DS2_ANALOG_SQUARE },
+		{ SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
+		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
+		{ SNES_UP,		PSX_UP,       DS2_ANALOG_U },
+		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
+		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
+		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
+		{ SNES_A,		PSX_O, DS2_ANALOG_O },
+		{ SNES_X,		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
+		{ SNES_R,		PSX_R1, DS2_ANALOG_R1 },
+		{ SNES_L,		PSX_L1, DS2_ANALOG_L1 },
+		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
+};
+
+static const struct map_ent type2_mapping[] PROGMEM = {
+		{ SNES_B, 		PSX_O, DS2_ANALOG_O },
+		{ SNES_Y, 		PSX_X, DS2_ANALOG_X },
+    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
+		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
+    { SNES_UP,		PSX_UP,       DS2_ANALOG_U },
+		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
+		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
+		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
+		{ SNES_A,		PSX_R2, DS2_ANALOG_R2 },
+		{ SNES_X,		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
+		{ SNES_R,		PSX_R1, DS2_ANALOG_R1 },
+		{ SNES_L,		PSX_SQUARE,   DS2_ANALOG_SQUARE },
+		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
+};
+
+static const struct map_ent type3_mapping[] PROGMEM = {
+		{ SNES_B, 		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
+		{ SNES_Y, 		PSX_O, DS2_ANALOG_O },
+    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
+		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
+    { SNES_UP,		PSX_UP,       DS2_ANALOG_U },
+		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
+		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
+		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
+		{ SNES_A,		PSX_X,   DS2_ANALOG_X },
+		{ SNES_X,		PSX_SQUARE,   DS2_ANALOG_SQUARE },
+		{ SNES_R,		PSX_R1, DS2_ANALOG_R1 },
+		{ SNES_L,		PSX_L1, DS2_ANALOG_L1 },
+		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
+};
+
+static const struct map_ent type4_mapping[] PROGMEM = {
+		{ SNES_B, 		PSX_SQUARE,   DS2_ANALOG_SQUARE },
+		{ SNES_Y, 		PSX_X,   DS2_ANALOG_X },
+    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
+		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
+    { SNES_UP,		PSX_UP,       DS2_ANALOG_U },
+		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
+		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
+		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
+		{ SNES_A,		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
+		{ SNES_X,		PSX_O, DS2_ANALOG_O },
+		{ SNES_R,		PSX_R1, DS2_ANALOG_R1 },
+		{ SNES_L,		PSX_L1, DS2_ANALOG_L1 },
+		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
+};
+
+static const struct map_ent type5_mapping[] PROGMEM = {
+		{ SNES_B, 		PSX_O, DS2_ANALOG_O },
+		{ SNES_Y, 		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
+    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
+		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
+    { SNES_UP,		PSX_UP,       DS2_ANALOG_U },
+		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
+		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
+		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
+		{ SNES_A,		PSX_SQUARE,   DS2_ANALOG_SQUARE },
+		{ SNES_X,		PSX_X,   DS2_ANALOG_X },
+		{ SNES_R,		PSX_L1, DS2_ANALOG_L1 }, // L/R swapped
+		{ SNES_L,		PSX_R1, DS2_ANALOG_R1 },
+		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
+};
+
+static const struct map_ent type6_mapping[] PROGMEM = { // Type 1 with L2/R2
+		{ SNES_B, 		PSX_X,   DS2_ANALOG_X },
+		{ SNES_Y, 		PSX_SQUARE,   DS2_ANALOG_SQUARE },
+    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
+		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
+    { SNES_UP,		PSX_UP,       DS2_ANALOG_U },
+		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
+		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
+		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
+		{ SNES_A,		PSX_O, DS2_ANALOG_O },
+		{ SNES_X,		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
+		{ SNES_R,		PSX_R2, DS2_ANALOG_R2 },
+		{ SNES_L,		PSX_L2, DS2_ANALOG_L2 },
+		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
+};
+
+static const struct map_ent type7_mapping[] PROGMEM = { // Type 1 with rotated directions for right-hand arcade stick steering
+		{ SNES_B, 		PSX_X,   DS2_ANALOG_X },
+		{ SNES_Y, 		PSX_SQUARE,   DS2_ANALOG_SQUARE },
+    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
+		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
+		{ SNES_UP,		PSX_DOWN,     DS2_ANALOG_D },
+		{ SNES_DOWN,	PSX_UP,       DS2_ANALOG_U },
+		{ SNES_LEFT,	PSX_RIGHT,    DS2_ANALOG_R },
+		{ SNES_RIGHT,	PSX_LEFT,     DS2_ANALOG_L },
+		{ SNES_A,		PSX_O, DS2_ANALOG_O },
+		{ SNES_X,		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
+		{ SNES_R,		PSX_L1, DS2_ANALOG_L1 },
+		{ SNES_L,		PSX_R1, DS2_ANALOG_R1 },
+		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
+};
+
+static const struct map_ent *const presets[NUM_PRESETS] PROGMEM = {
+	type1_mapping,
+	type2_mapping,
+	type3_mapping,
+	type4_mapping,
+	type5_mapping,
+	type6_mapping,
+	type7_mapping,
+};
+
+char config_usePreset(unsigned char type)
+{
+	if (type < 1 || type > NUM_PRESETS)
+		return -1;
+
+	memcpy_P(g_cfg.map, pgm_read_ptr(&presets[type-1]), sizeof(g_cfg.map));
+	g_cfg.preset = type;
+	g_map_serial++;
+
+	return 0;
+}
+
+void config_lock(void)
+{
+	while (1) {
+		while (CHIP_SELECT_ACTIVE()) { }
+		cli();
+		if (!CHIP_SELECT_ACTIVE())
+			return;
+		sei();
+	}
+}
+
+char config_check(const struct adapter_config *cfg)
+{
+	unsigned char i;
+
+	if (cfg->deviceID != DEVICE_ID_DIGITAL_PS1 &&
+			cfg->deviceID != DEVICE_ID_DUALSHOCK2)
+		return -1;
+
+	// _delay_loop_1(0) is 256 iterations
+	if (!cfg->ack_delay || !cfg->ack_width)
+		return -1;
+
+	for (i=0; i<NUM_MAP_ENTRIES; i++) {
+		if (cfg->map[i].analogByte > MAX_DS2_ANALOG_BUTTONS)
+			return -1;
+	}
+
+	if (cfg->map[NUM_MAP_ENTRIES].s)
+		return -1;
+
+	for (i=0; i<NUM_PROFILES; i++) {
+		if (cfg->profiles[i].deviceID &&
+				cfg->profiles[i].deviceID != DEVICE_ID_DIGITAL_PS1 &&
+				cfg->profiles[i].deviceID != DEVICE_ID_DUALSHOCK2)
+			return -1;
+		if (cfg->profiles[i].preset > NUM_PRESETS)
+			return -1;
+	}
+
+	return 0;
+}
+
+char config_apply(const struct adapter_config *cfg)
+{
+	if (config_check(cfg))
+		return -1;
+
+	memcpy(g_cfg.map, cfg->map, sizeof(g_cfg.map));
+	memcpy(g_cfg.profiles, cfg->profiles, sizeof(g_cfg.profiles));
+	g_cfg.preset = cfg->preset;
+	g_map_serial++;
+
+	config_lock();
+	g_cfg.deviceID = cfg->deviceID;
+	g_cfg.ack_delay = cfg->ack_delay;
+	g_cfg.ack_width = cfg->ack_width;
+	config_unlock();
+
+	return 0;
+}
+
+static unsigned char checksum(const struct adapter_config *cfg)
+{
+	const unsigned char *p = (const unsigned char *)cfg;
+	unsigned char sum = 0;
+	unsigned char i;
+
+	for (i=0; i<sizeof(struct adapter_config); i++)
+		sum += p[i];
+
+	return sum;
+}
+
+char config_load(void)
+{
+	struct adapter_config tmp;
+
+	if (eeprom_read_word(&ee_config.magic) != CONFIG_MAGIC)
+		return -1;
+
+	eeprom_read_block(&tmp, &ee_config.cfg, sizeof(tmp));
+	if (eeprom_read_byte(&ee_config.sum) != checksum(&tmp))
+		return -1;
+
+	if (config_check(&tmp))
+		return -1;
+
+	memcpy(&g_cfg, &tmp, sizeof(g_cfg));
+	g_map_serial++;
+
+	return 0;
+}
+
+void config_save(void)
+{
+	save_pos = 0;
+	save_end = SAVE_STEPS;
+}
+
+void config_erase(void)
+{
+	save_pos = 0;
+	save_end = sizeof(ee_config.magic);
+}
+
+/* Write one byte of ee_config: the magic is invalidated, then g_cfg is
+ * written with its sum, and the magic again. If g_cfg changed while it
+ * was written, it is written again. */
+static void saveStep(void)
+{
+	unsigned char *dst = (unsigned char *)&ee_config + save_pos;
+	const unsigned char *cfg = (const unsigned char *)&g_cfg;
+	unsigned char val, i;
+
+	if (save_pos < sizeof(ee_config.magic)) {
+		val = 0xff;
+		save_sum = 0;
+	}
+	else if (save_pos < SAVE_SUM) {
+		val = cfg[save_pos - offsetof(struct eeprom_config, cfg)];
+		save_sum += val;
+	}
+	else if (save_pos == SAVE_SUM) {
+		for (i=0; i<sizeof(g_cfg); i++) {
+			if (eeprom_read_byte((unsigned char *)&ee_config.cfg + i) != cfg[i]) {
+				save_pos = offsetof(struct eeprom_config, cfg);
+				save_sum = 0;
+				return;
+			}
+		}
+		val = save_sum;
+	}
+	else {
+		// Little endian, as eeprom_read_word()
+		dst = (unsigned char *)&ee_config.magic + save_pos - (SAVE_SUM + 1);
+		val = CONFIG_MAGIC >> ((save_pos - (SAVE_SUM + 1)) * 8);
+	}
+
+	eeprom_update_byte(dst, val);
+	save_pos++;
+}
+
+unsigned char config_saving(void)
+{
+	return save_pos != save_end;
+}
+
+void config_poll(void)
+{
+	if (save_pos != save_end && eeprom_is_ready())
+		saveStep();
+}
@@ -0,0 +1,112 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _config_h__
+#define _config_h__
+
+#include "hal.h"
+
+#define NUM_MAP_ENTRIES	12
+#define NUM_PRESETS		7
+#define NUM_PROFILES	4
+
+/* Acknowledge timing, in _delay_loop_1() iterations (3 cycles each).
+ * The defaults are 9 and 24 cycles at 8MHz, plus a few cycles to load
+ * the setting: about 1.1us and 3us, the _delay_us(1) and _delay_us(3)
+ * used before these were configurable. */
+#define DEFAULT_ACK_DELAY	3
+#define DEFAULT_ACK_WIDTH	8
+
+struct map_ent {
+	unsigned short s; // Snes bit
+	unsigned short p; // PSX bit
+  unsigned char analogByte;
+};
+
+/* Settings applied automatically to a game, see profile.h.
+ * deviceID or preset 0 leave the current setting alone. An entry
+ * with both set to 0 is unused. */
+struct profile_ent {
+	unsigned short fingerprint;
+	unsigned char deviceID;
+	unsigned char preset;
+};
+
+struct adapter_config {
+	unsigned char deviceID;
+	unsigned char ack_delay;	// Delay before pulling acknowledge
+	unsigned char ack_width;	// How long acknowledge is held low
+	unsigned char preset;		// Preset the mapping was loaded from (0 if edited)
+	struct map_ent map[NUM_MAP_ENTRIES + 1]; // Terminated by s == 0
+	struct profile_ent profiles[NUM_PROFILES];
+};
+
+extern struct adapter_config g_cfg;
+
+/* EEPROM layout. Each area has a fixed address, so a module's data
+ * does not move when another module or the link order changes. The
+ * config area is at 0, where it always was, with room for
+ * struct adapter_config to grow. */
+#define EE_CONFIG_ADDR		0
+#define EE_CONFIG_SIZE		128
+#define EE_RECORDER_ADDR	(EE_CONFIG_ADDR + EE_CONFIG_SIZE)
+
+/* Incremented each time g_cfg.map changes, for code that caches
+ * something derived from it. */
+extern unsigned char g_map_serial;
+
+/* Returns with interrupts disabled once attention is deasserted. The
+ * fields used by the PSX interrupt handler (deviceID, ack timing) may
+ * then be changed without affecting a transaction, until config_unlock(). */
+void config_lock(void);
+#define config_unlock()	sei()
+
+/* Returns 0 if cfg is safe to use, -1 otherwise. */
+char config_check(const struct adapter_config *cfg);
+
+/* Check and install cfg as the live configuration. The map is copied
+ * with interrupts enabled since the PSX interrupt handler does not use it.
+ * Returns 0 on success, -1 if cfg was rejected. */
+char config_apply(const struct adapter_config *cfg);
+
+/* Copy one of the built-in mappings (1 to NUM_PRESETS) to g_cfg.map.
+ * Returns 0 on success, -1 if the preset does not exist. */
+char config_usePreset(unsigned char type);
+
+/* Load g_cfg from EEPROM. Returns 0 on success, -1 if the EEPROM
+ * does not hold a valid configuration (g_cfg is left untouched).
+ * Call before interrupts are enabled. */
+char config_load(void);
+
+/* Start storing g_cfg to EEPROM. config_poll() writes it a byte at a
+ * time, each taking several milliseconds when it changed. The stored
+ * configuration is invalid until the last byte is written. */
+void config_save(void);
+
+/* Start invalidating the stored configuration so defaults are used at
+ * next boot. Cancels a save in progress. */
+void config_erase(void);
+
+/* Call from the main loop. Writes the next byte of a save or erase,
+ * unless the EEPROM is still busy with the last one. */
+void config_poll(void);
+
+/* Non-zero until the last byte of a save or erase is written. */
+unsigned char config_saving(void);
+
+#endif // _config_h__
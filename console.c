@@ -0,0 +1,321 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "snes2ps.h"
+#include "config.h"
+#include "uart.h"
+#include "console.h"
+#include "profile.h"
+#include "health.h"
+#include "recorder.h"
+
+enum {
+	RX_SYNC = 0,
+	RX_CMD,
+	RX_LEN,
+	RX_DATA,
+	RX_SUM,
+};
+
+static unsigned char rx_state = RX_SYNC;
+static unsigned char rx_cmd;
+static unsigned char rx_len;
+static unsigned char rx_pos;
+static unsigned char rx_sum;
+static unsigned char rx_data[CONSOLE_MAX_PAYLOAD];
+
+static unsigned char tx_sum;
+
+/* CONSOLE_CMD_READ_MAP, the largest reply: header, data and sum. Only
+ * one reply is queued at a time, so uart_putc() never waits. */
+#define MAX_REPLY	(4 + NUM_MAP_ENTRIES * 5 + 1)
+
+#if UART_TX_SIZE <= MAX_REPLY
+#error UART_TX_SIZE too small for a whole reply
+#endif
+
+static void txByte(unsigned char c)
+{
+	tx_sum += c;
+	uart_putc(c);
+}
+
+static void txWord(unsigned short w)
+{
+	txByte(w >> 8);
+	txByte(w & 0xff);
+}
+
+static void replyBegin(unsigned char status, unsigned char len)
+{
+	uart_putc(CONSOLE_SYNC);
+	tx_sum = 0;
+	txByte(rx_cmd);
+	txByte(status);
+	txByte(len);
+}
+
+static void replyEnd(void)
+{
+	uart_putc(-tx_sum);
+}
+
+static void replyStatus(unsigned char status)
+{
+	replyBegin(status, 0);
+	replyEnd();
+}
+
+static unsigned short getWord(const unsigned char *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static void execute(void)
+{
+	unsigned char i;
+	struct map_ent *ent;
+#ifdef WITH_PROFILES
+	struct profile_ent *prof;
+#endif
+	struct psx_counters cnt;
+#ifdef WITH_RECORDER
+	struct rec_ent rec;
+	unsigned char total, n;
+#endif
+
+	switch (rx_cmd)
+	{
+		case CONSOLE_CMD_GET_INFO:
+			replyBegin(CONSOLE_OK, 5);
+			txByte(CONSOLE_PROTOCOL_VERSION);
+			txByte(g_cfg.deviceID);
+			txByte(g_cfg.ack_delay);
+			txByte(g_cfg.ack_width);
+			txByte(g_cfg.preset);
+			replyEnd();
+			return;
+
+		case CONSOLE_CMD_READ_MAP:
+			replyBegin(CONSOLE_OK, NUM_MAP_ENTRIES * 5);
+			for (i=0; i<NUM_MAP_ENTRIES; i++) {
+				txWord(g_cfg.map[i].s);
+				txWord(g_cfg.map[i].p);
+				txByte(g_cfg.map[i].analogByte);
+			}
+			replyEnd();
+			return;
+
+		case CONSOLE_CMD_WRITE_MAP:
+			if (rx_len != 6 || rx_data[0] >= NUM_MAP_ENTRIES ||
+					rx_data[5] > MAX_DS2_ANALOG_BUTTONS)
+				break;
+			// The map is only used from the main loop, no locking required.
+			ent = &g_cfg.map[rx_data[0]];
+			ent->s = getWord(rx_data + 1);
+			ent->p = getWord(rx_data + 3);
+			ent->analogByte = rx_data[5];
+			g_cfg.preset = 0;
+			g_map_serial++;
+			replyStatus(CONSOLE_OK);
+			return;
+
+		case CONSOLE_CMD_USE_PRESET:
+			if (rx_len != 1 || config_usePreset(rx_data[0]))
+				break;
+			replyStatus(CONSOLE_OK);
+			return;
+
+		case CONSOLE_CMD_SET_MODE:
+			if (rx_len != 1 || (rx_data[0] != DEVICE_ID_DIGITAL_PS1 &&
+								rx_data[0] != DEVICE_ID_DUALSHOCK2))
+				break;
+			config_lock();
+			g_cfg.deviceID = rx_data[0];
+			config_unlock();
+			replyStatus(CONSOLE_OK);
+			return;
+
+		case CONSOLE_CMD_SET_ACK:
+			if (rx_len != 2 || !rx_data[0] || !rx_data[1])
+				break;
+			config_lock();
+			g_cfg.ack_delay = rx_data[0];
+			g_cfg.ack_width = rx_data[1];
+			config_unlock();
+			replyStatus(CONSOLE_OK);
+			return;
+
+		case CONSOLE_CMD_GET_COUNTERS:
+			cli();
+			cnt = g_counters;
+			sei();
+			replyBegin(CONSOLE_OK, 4);
+			txWord(cnt.polls);
+			txWord(cnt.ignored);
+			replyEnd();
+			return;
+
+		case CONSOLE_CMD_SAVE:
+			// Written in the background by config_poll()
+			config_save();
+			replyStatus(CONSOLE_OK);
+			return;
+
+		case CONSOLE_CMD_ERASE:
+			config_erase();
+			replyStatus(CONSOLE_OK);
+			return;
+
+#ifdef WITH_PROFILES
+		case CONSOLE_CMD_GET_FINGERPRINT:
+			replyBegin(CONSOLE_OK, 5);
+			txByte(g_profile.done);
+			txByte(g_profile.match);
+			txWord(g_profile.fingerprint);
+			txByte(g_profile.len);
+			replyEnd();
+			return;
+
+		case CONSOLE_CMD_READ_PROFILES:
+			replyBegin(CONSOLE_OK, NUM_PROFILES * 4);
+			for (i=0; i<NUM_PROFILES; i++) {
+				txWord(g_cfg.profiles[i].fingerprint);
+				txByte(g_cfg.profiles[i].deviceID);
+				txByte(g_cfg.profiles[i].preset);
+			}
+			replyEnd();
+			return;
+
+		case CONSOLE_CMD_WRITE_PROFILE:
+			if (rx_len != 5 || rx_data[0] >= NUM_PROFILES || rx_data[4] > NUM_PRESETS)
+				break;
+			if (rx_data[3] && rx_data[3] != DEVICE_ID_DIGITAL_PS1 &&
+								rx_data[3] != DEVICE_ID_DUALSHOCK2)
+				break;
+			prof = &g_cfg.profiles[rx_data[0]];
+			prof->fingerprint = getWord(rx_data + 1);
+			prof->deviceID = rx_data[3];
+			prof->preset = rx_data[4];
+			replyStatus(CONSOLE_OK);
+			return;
+#endif
+
+#ifdef WITH_HEALTH
+		case CONSOLE_CMD_GET_HEALTH:
+			replyBegin(CONSOLE_OK, 2);
+			txByte(g_health.faults);
+			txByte(g_health.osccal);
+			replyEnd();
+			return;
+#endif
+
+#ifdef WITH_RECORDER
+		case CONSOLE_CMD_READ_RECORDING:
+			if (rx_len != 2 || rx_data[0] > 1)
+				break;
+			if (!rx_data[0] && !rx_data[1])
+				recorder_freeze();
+			total = recorder_count(rx_data[0]);
+			n = rx_data[1] < total ? total - rx_data[1] : 0;
+			if (n > CONSOLE_REC_CHUNK)
+				n = CONSOLE_REC_CHUNK;
+			replyBegin(CONSOLE_OK, 1 + n * 3);
+			txByte(total);
+			for (i=0; i<n; i++) {
+				recorder_get(rx_data[0], rx_data[1] + i, &rec);
+				txByte(rec.run);
+				txByte(rec.b0);
+				txByte(rec.b1);
+			}
+			replyEnd();
+			if (!rx_data[0] && rx_data[1] + n >= total)
+				recorder_resume();
+			return;
+#endif
+
+		default:
+			replyStatus(CONSOLE_ERR_UNKNOWN);
+			return;
+	}
+
+	replyStatus(CONSOLE_ERR_ARGUMENT);
+}
+
+void console_init(void)
+{
+	uart_init();
+	rx_state = RX_SYNC;
+}
+
+void console_poll(void)
+{
+	int c;
+
+	// Requests wait in the receive buffer until the last reply is out
+	if (uart_txBusy())
+		return;
+
+	while ((c = uart_getc()) >= 0)
+	{
+		rx_sum += c;
+
+		switch (rx_state)
+		{
+			case RX_SYNC:
+				if (c == CONSOLE_SYNC) {
+					rx_sum = 0;
+					rx_state = RX_CMD;
+				}
+				break;
+
+			case RX_CMD:
+				rx_cmd = c;
+				rx_state = RX_LEN;
+				break;
+
+			case RX_LEN:
+				rx_len = c;
+				rx_pos = 0;
+				if (rx_len > CONSOLE_MAX_PAYLOAD) {
+					replyStatus(CONSOLE_ERR_ARGUMENT);
+					rx_state = RX_SYNC;
+					return;
+				} else {
+					rx_state = rx_len ? RX_DATA : RX_SUM;
+				}
+				break;
+
+			case RX_DATA:
+				rx_data[rx_pos++] = c;
+				if (rx_pos == rx_len)
+					rx_state = RX_SUM;
+				break;
+
+			case RX_SUM:
+				if (rx_sum)
+					replyStatus(CONSOLE_ERR_CHECKSUM);
+				else
+					execute();
+				rx_state = RX_SYNC;
+				return;
+		}
+	}
+}
@@ -0,0 +1,98 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _console_h__
+#define _console_h__
+
+/* Binary configuration protocol on the USART (38400 8N1).
+ *
+ * Request: 0xA5, cmd, len, data[len], sum
+ * Reply:   0xA5, cmd, status, len, data[len], sum
+ *
+ * sum is chosen so the 8 bit sum of every byte following 0xA5 is zero.
+ * Send the next request once the reply to the last one is received:
+ * requests are not read while a reply is being sent, and bytes that do
+ * not fit in the receive buffer (UART_RX_SIZE) are dropped.
+ * Multi-byte values are sent MSB first. Bytes received while waiting for
+ * 0xA5 are dropped, so a host that lost sync can recover by sending
+ * CONSOLE_MAX_PAYLOAD + 3 zeros and waiting for the error reply.
+ *
+ * Changes take effect immediately. Settings used by the PSX interrupt
+ * handler are only changed while attention is deasserted, so a
+ * transaction never sees a mix of old and new values. Nothing is
+ * written to EEPROM until CONSOLE_CMD_SAVE is received.
+ *
+ * The fingerprint and profile, health and recording commands are only
+ * there with WITH_PROFILES, WITH_HEALTH and WITH_RECORDER respectively.
+ */
+#define CONSOLE_SYNC				0xA5
+#define CONSOLE_PROTOCOL_VERSION	1
+#define CONSOLE_MAX_PAYLOAD			8
+
+/* Reply: version, device ID, ack delay, ack width, preset */
+#define CONSOLE_CMD_GET_INFO		0x01
+/* Reply: NUM_MAP_ENTRIES x (snes bit (2), psx bit (2), analog byte index) */
+#define CONSOLE_CMD_READ_MAP		0x02
+/* Data: entry index, snes bit (2), psx bit (2), analog byte index */
+#define CONSOLE_CMD_WRITE_MAP		0x03
+/* Data: preset number (1 to NUM_PRESETS) */
+#define CONSOLE_CMD_USE_PRESET		0x04
+/* Data: device ID (DEVICE_ID_DIGITAL_PS1 or DEVICE_ID_DUALSHOCK2) */
+#define CONSOLE_CMD_SET_MODE		0x05
+/* Data: ack delay, ack width (in _delay_loop_1 iterations, non-zero) */
+#define CONSOLE_CMD_SET_ACK			0x06
+/* Reply: polls (2), ignored (2) */
+#define CONSOLE_CMD_GET_COUNTERS	0x07
+/* Write the current configuration to EEPROM. Replies at once, the
+ * bytes are written over the next few hundred milliseconds. */
+#define CONSOLE_CMD_SAVE			0x08
+/* Forget the EEPROM configuration (defaults and boot chords apply again) */
+#define CONSOLE_CMD_ERASE			0x09
+/* Reply: done, match, fingerprint (2), bytes recorded (see profile.h) */
+#define CONSOLE_CMD_GET_FINGERPRINT	0x0A
+/* Reply: NUM_PROFILES x (fingerprint (2), device ID, preset) */
+#define CONSOLE_CMD_READ_PROFILES	0x0B
+/* Data: slot (0 to NUM_PROFILES-1), fingerprint (2), device ID, preset */
+#define CONSOLE_CMD_WRITE_PROFILE	0x0C
+/* Reply: faults, OSCCAL (see health.h) */
+#define CONSOLE_CMD_GET_HEALTH		0x0D
+/* Data: source (0 live, 1 saved to EEPROM), first entry (0 is the oldest)
+ * Reply: number of entries, up to CONSOLE_REC_CHUNK x (polls, button byte 0,
+ * button byte 1) (see recorder.h). Reading entry 0 of the live recording
+ * pauses it until its last entry is read, or RECORDER_READ_TIMEOUT_MS. */
+#define CONSOLE_CMD_READ_RECORDING	0x0E
+
+#define CONSOLE_REC_CHUNK			16
+
+#define CONSOLE_OK					0x00
+#define CONSOLE_ERR_CHECKSUM		0x01
+#define CONSOLE_ERR_UNKNOWN			0x02
+#define CONSOLE_ERR_ARGUMENT		0x03
+
+#ifdef WITH_CONSOLE
+void console_init(void);
+
+/* Call from the main loop. Consumes the received bytes and executes
+ * the request once it is complete. */
+void console_poll(void);
+#else
+#define console_init()	do { } while(0)
+#define console_poll()	do { } while(0)
+#endif
+
+#endif // _console_h__
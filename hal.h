@@ -0,0 +1,110 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _hal_h__
+#define _hal_h__
+
+/* Hardware access for the protocol core (psx.c, config.c, buscfg.c,
+ * profile.c and recorder.c).
+ *
+ * On the AVR these are the register accesses the code always used, so
+ * the core compiles to the same instructions. Other builds get the
+ * models in host/hal_host.h instead.
+ *
+ *  HAL_PSX_HANDLER()    Definition line of the per-byte handler
+ *  HAL_PSX_ATTN_HANDLER() Definition line of the attention deasserted handler
+ *  HAL_PSX_RX()         Last byte received from the console
+ *  HAL_PSX_TX(x)        Byte sent during the next exchange (inverted on the wire)
+ *  HAL_PSX_PENDING()    Non-zero once a byte was exchanged and not yet handled
+ *  CHIP_SELECT_ACTIVE() Attention asserted
+ *  HAL_PSX_ACK_LOW()    Pull acknowledge
+ *  HAL_PSX_ACK_RELEASE()
+ *  SNES_*               4021 latch, clock and data lines
+ *  HAL_DELAY_LOOP(n)    _delay_loop_1(n)
+ *  HAL_DELAY_US(us)     _delay_us(us), us must be a constant
+ *  HAL_EEPROM(addr)     Pointer to EEPROM address addr, for eeprom_*()
+ *  HAL_EEPROM_SIZE      EEPROM size in bytes
+ *
+ * Flash and EEPROM access, cli()/sei() and _crc_ccitt_update() keep their
+ * avr-libc names. timer_ms() (timer.h) is provided by timer.c or by the
+ * host model.
+ */
+#ifdef __AVR__
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+#include <util/delay_basic.h>
+#include <util/crc16.h>
+
+/******** IO port definitions **************/
+#define SNES_LATCH_DDR  DDRC
+#define SNES_LATCH_PORT PORTC
+#define SNES_LATCH_BIT  (1<<4)
+
+#define SNES_CLOCK_DDR  DDRC
+#define SNES_CLOCK_PORT PORTC
+#define SNES_CLOCK_BIT  (1<<5)
+
+#define SNES_DATA_PORT  PORTC
+#define SNES_DATA_DDR   DDRC
+#define SNES_DATA_PIN   PINC
+#define SNES_DATA_BIT   (1<<3)
+
+#define PSX_ACK_PORT	PORTC
+#define PSX_ACK_DDR		DDRC
+#define PSX_ACK_PIN		PINC
+#define PSX_ACK_BIT		(1<<0)
+
+/* Attention from the PSX, on PB2 (shorted to PB0 and PB1) */
+#define CHIP_SELECT_ACTIVE()	(0 == (PINB & (1<<2)))
+
+#define HAL_PSX_HANDLER()	ISR(SPI_STC_vect)
+/* Rising edge on PB0, the input capture pin (see main()) */
+#define HAL_PSX_ATTN_HANDLER()	ISR(TIMER1_CAPT_vect)
+#define HAL_PSX_RX()		SPDR
+#define HAL_PSX_TX(x)		do { SPDR = (x); } while(0)
+#define HAL_PSX_PENDING()	(SPSR & (1<<SPIF))
+
+/* Simulate an open-collector by changing the direction */
+#define HAL_PSX_ACK_LOW()		do { PSX_ACK_PORT &= ~PSX_ACK_BIT; PSX_ACK_DDR |= PSX_ACK_BIT; } while(0)
+#define HAL_PSX_ACK_RELEASE()	do { PSX_ACK_DDR &= ~PSX_ACK_BIT; } while(0)
+
+/********* IO pins manipulation macros **********/
+#define SNES_LATCH_LOW()    do { SNES_LATCH_PORT &= ~(SNES_LATCH_BIT); } while(0)
+#define SNES_LATCH_HIGH()   do { SNES_LATCH_PORT |= SNES_LATCH_BIT; } while(0)
+#define SNES_CLOCK_LOW()    do { SNES_CLOCK_PORT &= ~(SNES_CLOCK_BIT); } while(0)
+#define SNES_CLOCK_HIGH()   do { SNES_CLOCK_PORT |= SNES_CLOCK_BIT; } while(0)
+
+#define SNES_GET_DATA() (SNES_DATA_PIN & SNES_DATA_BIT)
+
+#define HAL_DELAY_LOOP(n)	_delay_loop_1(n)
+#define HAL_DELAY_US(us)	_delay_us(us)
+
+#define HAL_EEPROM(addr)	((void *)(addr))
+#define HAL_EEPROM_SIZE		(E2END + 1)
+
+#else
+
+#include "host/hal_host.h"
+
+#endif
+
+#endif // _hal_h__
@@ -0,0 +1,71 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <avr/io.h>
+#include "health.h"
+#include "timer.h"
+
+#define HEALTH_LED_PORT	PORTD
+#define HEALTH_LED_DDR	DDRD
+#define HEALTH_LED_BIT	(1<<6)
+
+struct health g_health;
+
+static unsigned char blinks;
+static unsigned char step;
+static unsigned short stepStart;
+
+void health_report(void)
+{
+	unsigned char f;
+
+	g_health.osccal = OSCCAL;
+	if (g_health.osccal < HEALTH_OSCCAL_MIN || g_health.osccal > HEALTH_OSCCAL_MAX)
+		g_health.faults |= HEALTH_OSCCAL;
+
+	if (!g_health.faults)
+		return;
+
+	for (f = g_health.faults, blinks = 1; !(f & 1); f >>= 1)
+		blinks++;
+
+	HEALTH_LED_PORT &= ~HEALTH_LED_BIT;
+	HEALTH_LED_DDR |= HEALTH_LED_BIT;
+}
+
+void health_poll(void)
+{
+	unsigned short now;
+
+	if (!blinks)
+		return;
+
+	now = timer_ms();
+	if ((unsigned short)(now - stepStart) < HEALTH_STEP_MS)
+		return;
+	stepStart = now;
+
+	// blinks on/off pairs, then a 6 step pause
+	if (++step >= blinks * 2 + 6)
+		step = 0;
+
+	if (step < blinks * 2 && !(step & 1))
+		HEALTH_LED_PORT |= HEALTH_LED_BIT;
+	else
+		HEALTH_LED_PORT &= ~HEALTH_LED_BIT;
+}
@@ -0,0 +1,71 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _health_h__
+#define _health_h__
+
+/* Power-up self test results.
+ *
+ * The controller checks look at what the data line does, which depends
+ * on the wiring and on what is plugged in. The OSCCAL check only catches
+ * a value at one end of the range, which no factory calibration gives. It cannot tell an
+ * Atmega8 running on the wrong calibration: at reset it loads its 1MHz
+ * byte, which is in range, and the 8MHz byte is only in the signature
+ * row, which the Atmega8 cannot read by itself.
+ */
+#define HEALTH_NO_PAD		0x01 // Data line not driven after the 16th bit
+#define HEALTH_UNSTABLE		0x02 // Two consecutive reads differ
+#define HEALTH_BAD_ID		0x04 // Bits 13 to 16 not all high (see below)
+#define HEALTH_OSCCAL		0x08 // OSCCAL outside HEALTH_OSCCAL_MIN/MAX
+
+/* A standard pad always sends bits 13 to 16 high. Anything else is a
+ * data line stuck low or shorted, or another device (the SNES mouse
+ * sends 0001 there). */
+#define HEALTH_ID_BITS		0x000f
+
+// LED blink step
+#define HEALTH_STEP_MS		131
+
+#ifndef HEALTH_OSCCAL_MIN
+#define HEALTH_OSCCAL_MIN	0x08
+#endif
+#ifndef HEALTH_OSCCAL_MAX
+#define HEALTH_OSCCAL_MAX	0xF7
+#endif
+
+struct health {
+	unsigned char faults;
+	unsigned char osccal;
+};
+
+extern struct health g_health;
+
+#ifdef WITH_HEALTH
+/* Evaluate g_health once the controller checks are done. */
+void health_report(void);
+
+/* Call from the main loop. When a fault was found, blinks the LED on
+ * PD6 as many times as the number of the lowest fault bit (1 to 4),
+ * then pauses. */
+void health_poll(void);
+#else
+#define health_report()	do { } while(0)
+#define health_poll()	do { } while(0)
+#endif
+
+#endif // _health_h__
@@ -0,0 +1,175 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Throughput of the protocol core on the PC: each poll is one main
+ * loop pass (controller read and translation) followed by a complete
+ * transaction with random buttons held. The replies are checked
+ * against a plain translation of the same buttons so a broken core
+ * cannot post good numbers.
+ *
+ * With WITH_LATE_SAMPLE (make bench-late), the buttons change between
+ * the main loop pass and the transaction in digital mode, so only
+ * replies from the controller read inside the transaction pass. A byte
+ * time too short for that read shows up as a bad reply.
+ *
+ * Usage: bench [polls] [byte time, see hal_host.h]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "hal.h"
+#include "snes2ps.h"
+#include "config.h"
+#include "recorder.h"
+#include "psx.h"
+
+static unsigned long rnd = 1;
+
+static unsigned short nextButtons(void)
+{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 7;
+	rnd ^= rnd << 17;
+	return rnd;
+}
+
+static unsigned short expected(unsigned short snesbits)
+{
+	unsigned short psxbits = 0xffff;
+	int i;
+
+	snesbits = RECORDER_MASK(snesbits);
+	for (i=0; g_cfg.map[i].s; i++) {
+		if (!(snesbits & g_cfg.map[i].s))
+			psxbits &= ~g_cfg.map[i].p;
+	}
+	return psxbits;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* New random buttons every hold polls */
+static int run(const char *name, unsigned char deviceID, unsigned char len, unsigned char hold, unsigned long polls)
+{
+	unsigned char cmd[21] = { 0x01, 0x42 };
+	unsigned char reply[21];
+	unsigned short buttons = 0xffff, psxbits;
+	unsigned long i;
+	int late = 0;
+	double t;
+
+#ifdef WITH_LATE_SAMPLE
+	// Not done in DualShock 2 mode, see lateSample()
+	late = deviceID != DEVICE_ID_DUALSHOCK2;
+#endif
+
+	g_cfg.deviceID = deviceID;
+	psx_init();
+
+	t = now();
+	for (i=0; i<polls; i++) {
+		if (i % hold == 0)
+			buttons = nextButtons();
+		if (!late)
+			hal_snes_buttons = buttons;
+
+		psx_poll();
+		hal_snes_buttons = buttons;
+		if (hal_psx_transfer(cmd, reply, len) != len - 1)
+			goto bad;
+
+		psxbits = expected(buttons);
+		if (reply[1] != deviceID || reply[2] != 0x5a ||
+				reply[3] != (psxbits >> 8) || reply[4] != (psxbits & 0xff))
+			goto bad;
+	}
+	t = now() - t;
+
+	printf("%-10s %8.2f Mpolls/s  %6.1f ns/poll\n", name, polls / t / 1e6, t * 1e9 / polls);
+	return 0;
+
+bad:
+	printf("%s: bad reply at poll %lu, buttons %04x:", name, i, buttons);
+	for (i=0; i<len; i++)
+		printf(" %02x", reply[i]);
+	printf("\n");
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long polls = 10000000;
+	unsigned char preset;
+	unsigned short acc = 0;
+	unsigned long i;
+	double t;
+
+	if (argc > 1)
+		polls = strtoul(argv[1], NULL, 0);
+#ifdef WITH_LATE_SAMPLE
+	// About one byte on the bus (32us at 250kHz) in controller bit
+	// reads, so the late read completes before the 3rd byte
+	hal_psx_byte_time = 20;
+#endif
+	if (argc > 2)
+		hal_psx_byte_time = strtoul(argv[2], NULL, 0);
+
+	for (preset=1; preset<=NUM_PRESETS; preset++) {
+		char name[16];
+
+		config_usePreset(preset);
+		snprintf(name, sizeof(name), "preset %d", preset);
+		if (run(name, DEVICE_ID_DIGITAL_PS1, 5, 1, polls))
+			return 1;
+	}
+
+	config_usePreset(1);
+	if (run("ds2", DEVICE_ID_DUALSHOCK2, 21, 1, polls))
+		return 1;
+
+	// Buttons usually stay the same for several frames
+	if (run("held", DEVICE_ID_DIGITAL_PS1, 5, 8, polls))
+		return 1;
+	if (run("ds2 held", DEVICE_ID_DUALSHOCK2, 21, 8, polls))
+		return 1;
+
+	// Main loop passes, one controller read each
+	t = now();
+	for (i=0; i<polls; i++) {
+		if (i % 256 == 0)
+			hal_snes_buttons = nextButtons();
+		acc += psx_poll();
+	}
+	t = now() - t;
+	printf("%-10s %8.2f M/s       %6.1f ns/pass\n", "main loop", polls / t / 1e6, t * 1e9 / polls);
+
+	t = now();
+	for (i=0; i<polls; i++)
+		acc += snes2psx(nextButtons());
+	t = now() - t;
+	printf("%-10s %8.2f M/s       %6.1f ns/call (%04x)\n", "snes2psx", polls / t / 1e6, t * 1e9 / polls, acc);
+
+	return 0;
+}
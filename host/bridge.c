@@ -0,0 +1,407 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Answers pad transactions for an emulator plugin or a test driver with
+ * the firmware's protocol core, over a Unix socket or stdin/stdout.
+ *
+ * Messages (stream, no padding):
+ *
+ *  'T' len cmd[len]   Run one transaction. Answered with
+ *                     'R' len reply[len] acks
+ *  'B' hi lo          Hold these controller lines (SNES_* order, 0 =
+ *                     pressed) until the next 'B'. Overrides the script.
+ *  'F'                Next frame, when started with -f.
+ *
+ * The whole transaction is sent at once since the core replies from
+ * inside the handler for some bytes (see HAL_PSX_PENDING). Pad plugins
+ * talking to the emulator byte by byte can send 0x01 0x42 followed by
+ * zeros: the replies do not depend on the other command bytes.
+ *
+ * Before each transaction the main loop runs once, so the reply holds
+ * the buttons of that moment, as with a real adapter polled right after
+ * its controller read.
+ *
+ * Script (-s), one line per change, held until the next line:
+ *
+ *   # frame  buttons
+ *   0
+ *   120      START
+ *   122
+ *   300      B RIGHT
+ *
+ * A frame is one transaction addressed to the pad (first byte 0x01),
+ * or one 'F' message with -f. Games polling more than once per frame
+ * need -f and a driver sending 'F' on each vblank.
+ *
+ * With -l, each transaction is logged as "frame buttons reply...", for
+ * lining up what the game received with the script.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/joystick.h>
+#include "hal.h"
+#include "snes2ps.h"
+#include "config.h"
+#include "buscfg.h"
+#include "profile.h"
+#include "recorder.h"
+#include "psx.h"
+
+#define MAX_LEN		255
+#define MAX_SCRIPT	65536
+
+struct script_ent {
+	unsigned long frame;
+	unsigned short buttons;
+};
+
+static struct script_ent *script;
+static int script_len, script_pos;
+static unsigned long frame;
+static int frameMessages;
+
+static const struct {
+	const char *name;
+	unsigned short bit;
+} names[] = {
+	{ "B", SNES_B }, { "Y", SNES_Y }, { "SELECT", SNES_SELECT }, { "START", SNES_START },
+	{ "UP", SNES_UP }, { "DOWN", SNES_DOWN }, { "LEFT", SNES_LEFT }, { "RIGHT", SNES_RIGHT },
+	{ "A", SNES_A }, { "X", SNES_X }, { "L", SNES_L }, { "R", SNES_R },
+};
+
+#define NUM_NAMES	(sizeof(names) / sizeof(names[0]))
+
+/* Joystick buttons of the common USB SNES pads, in SNES_* order above.
+ * The d-pad is on axes 0 and 1. */
+static const unsigned char js_buttons[NUM_NAMES] = { 2, 3, 8, 9, 0xff, 0xff, 0xff, 0xff, 1, 0, 4, 5 };
+
+static int js_fd = -1;
+static unsigned short js_state = 0xffff;
+
+static int loadScript(const char *filename)
+{
+	FILE *fptr;
+	char line[256];
+	char *tok;
+	int lineno = 0;
+	unsigned int i;
+
+	fptr = fopen(filename, "r");
+	if (!fptr) {
+		perror(filename);
+		return -1;
+	}
+
+	script = malloc(MAX_SCRIPT * sizeof(struct script_ent));
+	if (!script)
+		goto fail;
+
+	while (fgets(line, sizeof(line), fptr)) {
+		lineno++;
+		tok = strtok(line, " \t\r\n");
+		if (!tok || tok[0] == '#')
+			continue;
+
+		if (script_len == MAX_SCRIPT) {
+			fprintf(stderr, "%s: too many lines\n", filename);
+			goto fail;
+		}
+
+		script[script_len].frame = strtoul(tok, NULL, 0);
+		script[script_len].buttons = 0xffff;
+
+		while ((tok = strtok(NULL, " \t\r\n"))) {
+			for (i=0; i<NUM_NAMES; i++) {
+				if (!strcasecmp(tok, names[i].name))
+					break;
+			}
+			if (i == NUM_NAMES) {
+				fprintf(stderr, "%s:%d: unknown button %s\n", filename, lineno, tok);
+				goto fail;
+			}
+			script[script_len].buttons &= ~names[i].bit;
+		}
+		script_len++;
+	}
+
+	fclose(fptr);
+	return 0;
+
+fail:
+	fclose(fptr);
+	return -1;
+}
+
+static void scriptUpdate(void)
+{
+	while (script_pos < script_len && script[script_pos].frame <= frame) {
+		hal_snes_buttons = script[script_pos].buttons;
+		script_pos++;
+	}
+}
+
+static void joystickUpdate(void)
+{
+	struct js_event e;
+	unsigned int i;
+
+	while (read(js_fd, &e, sizeof(e)) == sizeof(e)) {
+		if ((e.type & ~JS_EVENT_INIT) == JS_EVENT_BUTTON) {
+			for (i=0; i<NUM_NAMES; i++) {
+				if (js_buttons[i] != e.number)
+					continue;
+				if (e.value)
+					js_state &= ~names[i].bit;
+				else
+					js_state |= names[i].bit;
+			}
+		}
+		else if ((e.type & ~JS_EVENT_INIT) == JS_EVENT_AXIS && e.number < 2) {
+			unsigned short lo = e.number ? SNES_UP : SNES_LEFT;
+			unsigned short hi = e.number ? SNES_DOWN : SNES_RIGHT;
+
+			js_state |= lo | hi;
+			if (e.value < -16384)
+				js_state &= ~lo;
+			else if (e.value > 16384)
+				js_state &= ~hi;
+		}
+	}
+
+	hal_snes_buttons = js_state;
+}
+
+static int readAll(int fd, unsigned char *buf, int len)
+{
+	int n;
+
+	while (len) {
+		n = read(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int writeAll(int fd, const unsigned char *buf, int len)
+{
+	int n;
+
+	while (len) {
+		n = write(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static void transaction(const unsigned char *cmd, unsigned char *reply, unsigned char len, FILE *log)
+{
+	struct timespec ts;
+	unsigned short buttons;
+	unsigned char acks;
+	int i;
+
+	if (js_fd >= 0)
+		joystickUpdate();
+	else if (script)
+		scriptUpdate();
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	hal_timer_ms = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	buttons = psx_poll();
+	buscfg_poll();
+	config_poll();
+	profile_poll();
+	recorder_poll(buttons);
+
+	acks = hal_psx_transfer(cmd, reply + 2, len);
+	reply[0] = 'R';
+	reply[1] = len;
+	reply[2 + len] = acks;
+
+	if (log) {
+		fprintf(log, "%lu %04x", frame, hal_snes_buttons);
+		for (i=0; i<len; i++)
+			fprintf(log, " %02x", reply[2 + i]);
+		fprintf(log, "\n");
+	}
+
+	if (!frameMessages && len && cmd[0] == 0x01)
+		frame++;
+}
+
+/* Returns when the peer disconnects or sends garbage. */
+static void serve(int in, int out, FILE *log)
+{
+	unsigned char msg[2 + MAX_LEN];
+	unsigned char reply[3 + MAX_LEN];
+
+	while (readAll(in, msg, 1) == 0) {
+		switch (msg[0])
+		{
+			case 'T':
+				if (readAll(in, msg + 1, 1) || readAll(in, msg + 2, msg[1]))
+					return;
+				transaction(msg + 2, reply, msg[1], log);
+				if (writeAll(out, reply, 3 + msg[1]))
+					return;
+				break;
+
+			case 'B':
+				if (readAll(in, msg + 1, 2))
+					return;
+				hal_snes_buttons = (msg[1] << 8) | msg[2];
+				free(script);
+				script = NULL;
+				break;
+
+			case 'F':
+				frame++;
+				break;
+
+			default:
+				fprintf(stderr, "Unknown message 0x%02x\n", msg[0]);
+				return;
+		}
+	}
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [options]\n\n", name);
+	printf("  -u path      Unix socket to listen on (default: stdin/stdout)\n");
+	printf("  -s file      Button script\n");
+	printf("  -j device    Read the buttons from a joystick (/dev/input/jsN)\n");
+	printf("  -f           Frames advance with 'F' messages\n");
+	printf("  -m preset    Mapping preset (default 1)\n");
+	printf("  -d           DualShock 2 mode\n");
+	printf("  -l file      Log each transaction\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *sockpath = NULL;
+	FILE *log = NULL;
+	unsigned char preset = 1;
+	unsigned char deviceID = DEVICE_ID_DIGITAL_PS1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "u:s:j:fm:dl:h")) != -1) {
+		switch (opt)
+		{
+			case 'u': sockpath = optarg; break;
+			case 's':
+				if (loadScript(optarg))
+					return 1;
+				break;
+			case 'j':
+				js_fd = open(optarg, O_RDONLY | O_NONBLOCK);
+				if (js_fd < 0) {
+					perror(optarg);
+					return 1;
+				}
+				break;
+			case 'f': frameMessages = 1; break;
+			case 'm': preset = atoi(optarg); break;
+			case 'd': deviceID = DEVICE_ID_DUALSHOCK2; break;
+			case 'l':
+				log = fopen(optarg, "w");
+				if (!log) {
+					perror(optarg);
+					return 1;
+				}
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	// A driver closing the socket is reported by write(), not fatal
+	signal(SIGPIPE, SIG_IGN);
+
+	if (config_usePreset(preset)) {
+		fprintf(stderr, "No preset %d\n", preset);
+		return 1;
+	}
+	g_cfg.deviceID = deviceID;
+	psx_init();
+	recorder_init();
+	buscfg_init();
+	// The options choose, as a boot chord does
+	profile_init(0);
+
+	if (!sockpath) {
+		serve(STDIN_FILENO, STDOUT_FILENO, log);
+	}
+	else {
+		struct sockaddr_un addr;
+		int s, c;
+
+		s = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (s < 0) {
+			perror("socket");
+			return 1;
+		}
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, sockpath, sizeof(addr.sun_path) - 1);
+		unlink(sockpath);
+
+		if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) || listen(s, 1)) {
+			perror(sockpath);
+			return 1;
+		}
+
+		// One client at a time, the state carries over
+		while ((c = accept(s, NULL, NULL)) >= 0) {
+			serve(c, c, log);
+			close(c);
+			if (log)
+				fflush(log);
+		}
+
+		unlink(sockpath);
+	}
+
+	if (log)
+		fclose(log);
+
+	return 0;
+}
@@ -0,0 +1,129 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "hal.h"
+#include "timer.h"
+
+/* The console side of the SPI exchange. tx is what the handler last
+ * wrote (SPDR), sent inverted by the open-collector output stage. */
+static struct {
+	const unsigned char *cmd;
+	unsigned char *reply;
+	unsigned char len;
+	unsigned char pos;
+	unsigned char rx;
+	unsigned char tx;
+	unsigned char pending;
+	unsigned short wait;
+} bus;
+
+unsigned char hal_psx_acks;
+unsigned short hal_psx_byte_time;
+
+unsigned short hal_timer_ms;
+
+unsigned char hal_eeprom[HAL_EEPROM_SIZE];
+
+unsigned short hal_snes_buttons = 0xffff;
+static unsigned short snes_shift;
+static unsigned char snes_latch, snes_clock = 1;
+
+static void exchange(void)
+{
+	bus.reply[bus.pos] = 0xff ^ bus.tx;
+	bus.rx = bus.cmd[bus.pos];
+	bus.pos++;
+	bus.pending = 1;
+	bus.wait = hal_psx_byte_time;
+}
+
+unsigned char hal_psx_rx(void)
+{
+	bus.pending = 0;
+	return bus.rx;
+}
+
+void hal_psx_tx(unsigned char c)
+{
+	// Like SPIF, cleared by the SPDR access
+	bus.pending = 0;
+	bus.tx = c;
+}
+
+unsigned char hal_psx_pending(void)
+{
+	if (!bus.pending && bus.pos < bus.len) {
+		if (bus.wait)
+			bus.wait--;
+		else
+			exchange();
+	}
+	return bus.pending;
+}
+
+unsigned char hal_psx_selected(void)
+{
+	return bus.pos < bus.len || bus.pending;
+}
+
+unsigned char hal_psx_transfer(const unsigned char *cmd, unsigned char *reply, unsigned char len)
+{
+	bus.cmd = cmd;
+	bus.reply = reply;
+	bus.len = len;
+	bus.pos = 0;
+	bus.pending = 0;
+	hal_psx_acks = 0;
+
+	while (bus.pending || bus.pos < bus.len) {
+		if (!bus.pending)
+			exchange();
+		hal_psx_byte();
+	}
+
+	// Attention deasserted
+	bus.len = 0;
+	hal_psx_attn();
+
+	return hal_psx_acks;
+}
+
+void hal_snes_latch(unsigned char high)
+{
+	if (high)
+		snes_shift = hal_snes_buttons;
+	snes_latch = high;
+}
+
+void hal_snes_clock(unsigned char high)
+{
+	// Shifts on the rising edge. Zeros follow the 16 buttons.
+	if (high && !snes_clock && !snes_latch)
+		snes_shift <<= 1;
+	snes_clock = high;
+}
+
+unsigned char hal_snes_data(void)
+{
+	return (snes_shift & 0x8000) ? 1 : 0;
+}
+
+unsigned short timer_ms(void)
+{
+	return hal_timer_ms;
+}
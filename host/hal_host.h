@@ -0,0 +1,114 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _hal_host_h__
+#define _hal_host_h__
+
+/* hal.h for a PC build of the protocol core (see hal_host.c).
+ *
+ * Flash and EEPROM are plain memory, interrupts do not exist and
+ * delays take no time. The console, the SNES controller and the
+ * millisecond timer are models driven with hal_psx_transfer(),
+ * hal_snes_buttons and hal_timer_ms. */
+#include <string.h>
+
+#define PROGMEM
+#define memcpy_P			memcpy
+#define pgm_read_byte(p)	(*(const unsigned char *)(p))
+#define pgm_read_word(p)	(*(const unsigned short *)(p))
+#define pgm_read_ptr(p)		(*(const void * const *)(p))
+
+#define eeprom_read_byte(p)				(*(p))
+#define eeprom_read_word(p)				(*(p))
+#define eeprom_read_block(dst, src, n)	memcpy(dst, src, n)
+#define eeprom_update_byte(p, v)		(*(p) = (v))
+#define eeprom_update_word(p, v)		(*(p) = (v))
+#define eeprom_update_block(src, dst, n)	memcpy(dst, src, n)
+#define eeprom_is_ready()				1
+
+/* The EEPROM contents, 0 at startup */
+#define HAL_EEPROM_SIZE		512
+#define HAL_EEPROM(addr)	((void *)(hal_eeprom + (addr)))
+extern unsigned char hal_eeprom[HAL_EEPROM_SIZE];
+
+#define cli()	do { } while(0)
+#define sei()	do { } while(0)
+
+/* As in avr-libc's util/crc16.h */
+static inline unsigned short _crc_ccitt_update(unsigned short crc, unsigned char data)
+{
+	data ^= crc & 0xff;
+	data ^= data << 4;
+
+	return ((((unsigned short)data << 8) | (crc >> 8)) ^ (unsigned char)(data >> 4) ^
+			((unsigned short)data << 3));
+}
+
+/* What timer_ms() (timer.h) returns. Advanced by the driver. */
+extern unsigned short hal_timer_ms;
+
+/* The handlers in psx.c, called by hal_psx_transfer() for each byte
+ * the byte handler did not wait for itself, and once attention is
+ * deasserted. */
+void hal_psx_byte(void);
+void hal_psx_attn(void);
+
+unsigned char hal_psx_rx(void);
+void hal_psx_tx(unsigned char c);
+unsigned char hal_psx_pending(void);
+unsigned char hal_psx_selected(void);
+
+extern unsigned char hal_psx_acks;
+
+#define HAL_PSX_HANDLER()		void hal_psx_byte(void)
+#define HAL_PSX_ATTN_HANDLER()	void hal_psx_attn(void)
+#define HAL_PSX_RX()			hal_psx_rx()
+#define HAL_PSX_TX(x)			hal_psx_tx(x)
+#define HAL_PSX_PENDING()		hal_psx_pending()
+#define CHIP_SELECT_ACTIVE()	hal_psx_selected()
+#define HAL_PSX_ACK_LOW()		do { hal_psx_acks++; } while(0)
+#define HAL_PSX_ACK_RELEASE()	do { } while(0)
+
+/* Run one transaction: send len command bytes, store the len bytes
+ * the handler replied with, as seen on the wire. Returns the number
+ * of times acknowledge was pulled. */
+unsigned char hal_psx_transfer(const unsigned char *cmd, unsigned char *reply, unsigned char len);
+
+/* Number of HAL_PSX_PENDING() calls before a byte the handler is
+ * waiting for arrives, modelling the time a byte takes on the bus.
+ * 0 (the default) makes the console infinitely fast. */
+extern unsigned short hal_psx_byte_time;
+
+void hal_snes_latch(unsigned char high);
+void hal_snes_clock(unsigned char high);
+unsigned char hal_snes_data(void);
+
+/* Lines of the simulated controller, in the SNES_* order, 0 meaning
+ * pressed. Loaded into the 4021 when latch goes high. */
+extern unsigned short hal_snes_buttons;
+
+#define SNES_LATCH_LOW()	hal_snes_latch(0)
+#define SNES_LATCH_HIGH()	hal_snes_latch(1)
+#define SNES_CLOCK_LOW()	hal_snes_clock(0)
+#define SNES_CLOCK_HIGH()	hal_snes_clock(1)
+#define SNES_GET_DATA()		hal_snes_data()
+
+#define HAL_DELAY_LOOP(n)	do { } while(0)
+#define HAL_DELAY_US(us)	do { } while(0)
+
+#endif // _hal_host_h__
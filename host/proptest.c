@@ -0,0 +1,773 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Random transactions against the protocol core, each reply checked
+ * against a reference model written from the descriptions in psx.h,
+ * buscfg.h, profile.h and recorder.h rather than from psx.c:
+ *
+ *  - button polls in both modes, with unusual command bytes, and cut short
+ *  - memory card transactions and configuration mode commands
+ *  - configuration reads with 0x70
+ *  - preset, mode and map changes between transactions
+ *  - the live recording and the fingerprint, re-armed by idle gaps
+ *  - transactions back to back, without a main loop pass in between
+ *  - with WITH_LATE_SAMPLE, buttons changing after the main loop read
+ *
+ * Then the recorder chord is held until the ring is saved, the
+ * configuration is saved and erased, uploaded with 0x70 (with a bad
+ * sum, a bad image and a good one), and a profile is saved for a known
+ * fingerprint, and applied and undone around idle gaps.
+ *
+ * Usage: proptest [iterations] [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "snes2ps.h"
+#include "config.h"
+#include "buscfg.h"
+#include "profile.h"
+#include "recorder.h"
+#include "psx.h"
+
+#define MAX_LEN		24
+
+static unsigned long rnd = 1;
+
+static unsigned long nextRandom(void)
+{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 7;
+	rnd ^= rnd << 17;
+	return rnd;
+}
+
+static unsigned long iteration;
+
+/* Controller bits and g_cfg as of the last main loop pass. Only when
+ * g_cfg did not change since, a transaction may follow the previous one
+ * without a main loop pass: the handler has to get ready by itself, and
+ * replies with the buttons read then. */
+static unsigned short lastRead = 0xffff;
+static struct adapter_config lastCfg;
+static int skipMainLoop;
+
+/******** Reference model **********/
+
+static unsigned short ref_polls;
+
+static struct rec_ent rec[RECORDER_SIZE];
+static int rec_head, rec_count;
+
+static unsigned char fp[FINGERPRINT_LEN];
+static int fp_len, fp_done;
+static unsigned short fp_start;
+
+/* CRC-CCITT as documented for _crc_ccitt_update() */
+static unsigned short crcCcitt(unsigned short crc, unsigned char c)
+{
+	int i;
+
+	crc ^= c;
+	for (i=0; i<8; i++)
+		crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+	return crc;
+}
+
+static void fpPut(unsigned char c)
+{
+	if (!fp_done && fp_len < FINGERPRINT_LEN)
+		fp[fp_len++] = c;
+}
+
+static void fpRearm(void)
+{
+	fp_len = 0;
+	fp_done = 0;
+	fp_start = ref_polls;
+}
+
+static void recRecord(unsigned char b0, unsigned char b1)
+{
+	struct rec_ent *e = &rec[rec_head];
+
+	if (e->b0 == b0 && e->b1 == b1 && e->run != 0xff) {
+		e->run++;
+		return;
+	}
+
+	rec_head = (rec_head + 1) % RECORDER_SIZE;
+	if (rec_count < RECORDER_SIZE)
+		rec_count++;
+	rec[rec_head].run = 1;
+	rec[rec_head].b0 = b0;
+	rec[rec_head].b1 = b1;
+}
+
+static unsigned short refButtons(unsigned short snesbits, unsigned char *analog)
+{
+	unsigned short psxbits = 0xffff;
+	unsigned char pressed[MAX_DS2_ANALOG_BUTTONS + 1];
+	int i;
+
+	// The game does not see the recorder chord
+	if (!(snesbits & RECORDER_CHORD))
+		snesbits |= RECORDER_CHORD;
+
+	memset(pressed, DS2_ANALOG_BUTTON_UNPRESSED, sizeof(pressed));
+	for (i=0; g_cfg.map[i].s; i++) {
+		int down = !(snesbits & g_cfg.map[i].s);
+
+		if (down)
+			psxbits &= ~g_cfg.map[i].p;
+		// The last entry for a byte decides
+		pressed[g_cfg.map[i].analogByte] = down ? DS2_ANALOG_BUTTON_PRESSED : DS2_ANALOG_BUTTON_UNPRESSED;
+	}
+	memcpy(analog, pressed, MAX_DS2_ANALOG_BUTTONS);
+
+	return psxbits;
+}
+
+/* Expected reply and number of acknowledges for a transaction, updating
+ * the recording and the fingerprint. Bytes the adapter does not drive
+ * read as 0xff. */
+static int refTransaction(const unsigned char *cmd, unsigned char *reply, int len, unsigned short snesbits)
+{
+	const unsigned char *image = (const unsigned char *)&g_cfg;
+	unsigned char analog[MAX_DS2_ANALOG_BUTTONS];
+	unsigned short psxbits;
+	int ds2 = g_cfg.deviceID == DEVICE_ID_DUALSHOCK2;
+	int acks = 0, n, i;
+
+	memset(reply, 0xff, len);
+	if (!len || cmd[0] != 0x01)
+		return 0;
+
+	ref_polls++;
+	acks = 1;
+	if (len < 2)
+		return acks;
+	reply[1] = g_cfg.deviceID;
+
+	switch (cmd[1])
+	{
+		case 0x42:
+			psxbits = refButtons(snesbits, analog);
+			reply[2] = 0x5a;
+			if (len > 3)
+				reply[3] = psxbits >> 8;
+			if (len > 4)
+				reply[4] = psxbits & 0xff;
+			if (len > 3 && (cmd[2] | cmd[3])) {
+				fpPut(0x42);
+				fpPut(cmd[2]);
+				fpPut(cmd[3]);
+			}
+			// Not while saved or read, see recorderTest()
+			if (len > 3 && !g_recorder.frozen)
+				recRecord(psxbits >> 8, psxbits & 0xff);
+			n = ds2 ? 21 : 5;
+			for (i=5; i<len && i<n; i++)
+				reply[i] = i < 9 ? DS2_STICK_CENTERED : analog[i - 9];
+			// All but the last byte of a complete poll
+			return len < n ? len : n - 1;
+
+		case CMD_VENDOR_CONFIG_70:
+			reply[2] = 0x5a;
+			acks++;
+			if (len < 3)
+				return acks;
+			reply[3] = g_buscfg.status;
+			acks++;
+			if (len < 4)
+				return acks;
+			if (cmd[2] == BUSCFG_OP_STATUS) {
+				if (len > 4)
+					reply[4] = BUSCFG_IMAGE_SIZE;
+				return acks + 1;
+			}
+			// BUSCFG_OP_READ, image bytes from arg until attention is
+			// deasserted, each one acknowledged
+			for (i=4; i<len; i++) {
+				unsigned int pos = cmd[3] + i - 4;
+
+				reply[i] = pos < BUSCFG_IMAGE_SIZE ? image[pos] : 0xff;
+			}
+			return len;
+
+		default:
+			// Configuration mode is not answered
+			fpPut(cmd[1]);
+			return acks;
+	}
+}
+
+/******** Core under test **********/
+
+static void mainLoop(void)
+{
+	unsigned short buttons;
+
+	buttons = psx_poll();
+	lastRead = hal_snes_buttons;
+	memcpy(&lastCfg, &g_cfg, sizeof(g_cfg));
+	buscfg_poll();
+	config_poll();
+	profile_poll();
+	recorder_poll(buttons);
+}
+
+/* No polls for a while: the fingerprint is re-armed */
+static void gap(void)
+{
+	// The main loop sees the last poll, then time passes
+	mainLoop();
+	hal_timer_ms += PROFILE_REARM_MS + nextRandom() % 1000;
+	mainLoop();
+	fpRearm();
+}
+
+static int fail(const char *what, const unsigned char *cmd, const unsigned char *exp, const unsigned char *got, int len)
+{
+	int i;
+
+	printf("iteration %lu: %s\n  cmd:     ", iteration, what);
+	for (i=0; i<len; i++)
+		printf(" %02x", cmd[i]);
+	if (exp) {
+		printf("\n  expected:");
+		for (i=0; i<len; i++)
+			printf(" %02x", exp[i]);
+		printf("\n  got:     ");
+		for (i=0; i<len; i++)
+			printf(" %02x", got[i]);
+	}
+	printf("\n");
+	return -1;
+}
+
+/* Also checks the fingerprint once the main loop ran */
+static int transaction(const unsigned char *cmd, int len, unsigned short snesbits)
+{
+	unsigned char exp[MAX_LEN], got[MAX_LEN];
+	int acks, exp_acks;
+	unsigned short crc = 0xffff;
+	int i;
+
+	if (skipMainLoop && !memcmp(&lastCfg, &g_cfg, sizeof(g_cfg))) {
+		snesbits = lastRead;
+		goto transfer;
+	}
+
+	hal_snes_buttons = snesbits;
+	mainLoop();
+
+	// profile_poll() ran with the polls so far
+	if (!fp_done && (fp_len == FINGERPRINT_LEN || (unsigned short)(ref_polls - fp_start) >= PROFILE_POLLS))
+		fp_done = 1;
+	if (g_profile.done != fp_done)
+		return fail(fp_done ? "fingerprint not done" : "fingerprint done early", cmd, NULL, NULL, len);
+	if (fp_done) {
+		for (i=0; i<fp_len; i++)
+			crc = crcCcitt(crc, fp[i]);
+		if (g_profile.len != fp_len || g_profile.fingerprint != crc)
+			return fail("wrong fingerprint", cmd, NULL, NULL, len);
+	}
+
+transfer:
+#ifdef WITH_LATE_SAMPLE
+	/* Half the time the buttons change after the main loop read, and
+	 * the bus leaves time for the late read to finish, so the new ones
+	 * are sent (not in DualShock 2 mode). Otherwise the late read gives
+	 * up at the 3rd byte and the main loop sample is sent. */
+	hal_psx_byte_time = 0;
+	if (nextRandom() % 2) {
+		hal_psx_byte_time = 16;
+		hal_snes_buttons = nextRandom() | 0x000f;
+		if (cmd[0] == 0x01 && cmd[1] == 0x42 && g_cfg.deviceID != DEVICE_ID_DUALSHOCK2)
+			snesbits = hal_snes_buttons;
+	}
+#endif
+	exp_acks = refTransaction(cmd, exp, len, snesbits);
+	acks = hal_psx_transfer(cmd, got, len);
+
+	if (memcmp(exp, got, len))
+		return fail("wrong reply", cmd, exp, got, len);
+	if (acks != exp_acks) {
+		printf("%d acknowledges, expected %d\n", acks, exp_acks);
+		return fail("wrong acknowledges", cmd, NULL, NULL, len);
+	}
+	if (g_counters.polls != ref_polls)
+		return fail("wrong poll count", cmd, NULL, NULL, len);
+
+	return 0;
+}
+
+static int checkRecording(void)
+{
+	struct rec_ent e;
+	int i, idx;
+
+	if (recorder_count(0) != rec_count) {
+		printf("iteration %lu: %d entries recorded, expected %d\n", iteration, recorder_count(0), rec_count);
+		return -1;
+	}
+
+	for (i=0; i<rec_count; i++) {
+		idx = (rec_head - rec_count + 1 + i + RECORDER_SIZE) % RECORDER_SIZE;
+		recorder_get(0, i, &e);
+		if (e.run != rec[idx].run || e.b0 != rec[idx].b0 || e.b1 != rec[idx].b1) {
+			printf("iteration %lu: entry %d is %d x %02x %02x, expected %d x %02x %02x\n", iteration, i,
+					e.run, e.b0, e.b1, rec[idx].run, rec[idx].b0, rec[idx].b1);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void randomChange(void)
+{
+	unsigned long r = nextRandom() % 100;
+	struct map_ent *ent;
+
+	if (r < 2) {
+		config_usePreset(1 + nextRandom() % NUM_PRESETS);
+	}
+	else if (r < 4) {
+		g_cfg.deviceID = g_cfg.deviceID == DEVICE_ID_DUALSHOCK2 ? DEVICE_ID_DIGITAL_PS1 : DEVICE_ID_DUALSHOCK2;
+	}
+	else if (r < 7) {
+		// As CONSOLE_CMD_WRITE_MAP. A 0 snes bit ends the map early.
+		ent = &g_cfg.map[nextRandom() % NUM_MAP_ENTRIES];
+		ent->s = (nextRandom() % 16) ? 0x10 << (nextRandom() % 12) : 0;
+		ent->p = 1 << (nextRandom() % 16);
+		ent->analogByte = nextRandom() % (MAX_DS2_ANALOG_BUTTONS + 1);
+		g_cfg.preset = 0;
+		g_map_serial++;
+	}
+}
+
+static int randomTransaction(unsigned short snesbits)
+{
+	static const unsigned char config_cmds[] = { 0x43, 0x44, 0x45, 0x4D, 0x4F };
+	unsigned char cmd[MAX_LEN];
+	int full = g_cfg.deviceID == DEVICE_ID_DUALSHOCK2 ? 21 : 5;
+	unsigned long r = nextRandom() % 100;
+	int len, i;
+
+	memset(cmd, 0, sizeof(cmd));
+	cmd[0] = 0x01;
+	cmd[1] = 0x42;
+	len = full;
+
+	if (r < 75) {
+		if (nextRandom() % 8 == 0) {
+			cmd[2] = nextRandom();
+			cmd[3] = nextRandom();
+		}
+	}
+	else if (r < 85) {
+		len = 1 + nextRandom() % full;
+	}
+	else if (r < 90) {
+		// Memory card
+		cmd[0] = 0x81;
+		for (i=1; i<MAX_LEN; i++)
+			cmd[i] = nextRandom();
+		len = 1 + nextRandom() % MAX_LEN;
+	}
+	else if (r < 93) {
+		cmd[1] = config_cmds[nextRandom() % sizeof(config_cmds)];
+		for (i=2; i<MAX_LEN; i++)
+			cmd[i] = nextRandom();
+		len = 2 + nextRandom() % 8;
+	}
+	else {
+		cmd[1] = CMD_VENDOR_CONFIG_70;
+		cmd[2] = nextRandom() % 4 ? BUSCFG_OP_READ : BUSCFG_OP_STATUS;
+		cmd[3] = nextRandom() % (BUSCFG_IMAGE_SIZE + 4);
+		len = 2 + nextRandom() % (MAX_LEN - 1);
+		if (cmd[2] == BUSCFG_OP_STATUS && len > 5)
+			len = 5;
+	}
+
+	return transaction(cmd, len, snesbits);
+}
+
+/* The chord saves the ring while polls go on, and a read stopped
+ * halfway does not stop recording for good */
+static int recorderTest(void)
+{
+	unsigned char cmd[5] = { 0x01, 0x42 };
+	struct rec_ent live[RECORDER_SIZE], saved;
+	unsigned short start;
+	int count, passes, i;
+
+	config_usePreset(1);
+	g_cfg.deviceID = DEVICE_ID_DIGITAL_PS1;
+
+	// The random part may have held the chord
+	for (passes=0; passes < 1000; passes++) {
+		if (transaction(cmd, 5, 0xffff))
+			return -1;
+	}
+
+	for (i=0; i<=RECORDER_CHORD_POLLS; i++) {
+		if (transaction(cmd, 5, ~RECORDER_CHORD))
+			return -1;
+	}
+	mainLoop();
+	if (!(g_recorder.frozen & RECORDER_FROZEN_SAVE)) {
+		printf("chord held, no save\n");
+		return -1;
+	}
+
+	count = recorder_count(0);
+	for (i=0; i<count; i++)
+		recorder_get(0, i, &live[i]);
+
+	// One EEPROM byte per pass
+	for (passes=0; g_recorder.frozen && passes < 1000; passes++) {
+		if (transaction(cmd, 5, 0xffff))
+			return -1;
+	}
+	if (passes < 100 || g_recorder.frozen) {
+		printf("save took %d passes\n", passes);
+		return -1;
+	}
+
+	if (recorder_count(1) != count) {
+		printf("%d entries saved, expected %d\n", recorder_count(1), count);
+		return -1;
+	}
+	for (i=0; i<count; i++) {
+		recorder_get(1, i, &saved);
+		if (memcmp(&saved, &live[i], sizeof(saved))) {
+			printf("saved entry %d differs\n", i);
+			return -1;
+		}
+	}
+
+	recorder_freeze();
+	start = hal_timer_ms;
+	mainLoop();
+	if (!(g_recorder.frozen & RECORDER_FROZEN_READ)) {
+		printf("not frozen for reading\n");
+		return -1;
+	}
+	while ((unsigned short)(hal_timer_ms - start) < RECORDER_READ_TIMEOUT_MS)
+		gap();
+	if (g_recorder.frozen) {
+		printf("still frozen after the read timeout\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* A save is written in the background, invalid until done. A change made
+ * meanwhile is saved too. */
+static int saveTest(void)
+{
+	unsigned char cmd[5] = { 0x01, 0x42 };
+	struct adapter_config saved;
+	int passes;
+
+	config_usePreset(2);
+	g_cfg.deviceID = DEVICE_ID_DIGITAL_PS1;
+	config_save();
+	for (passes=0; passes < 20; passes++) {
+		if (transaction(cmd, 5, 0xffff))
+			return -1;
+	}
+	if (!config_load()) {
+		printf("configuration valid while saved\n");
+		return -1;
+	}
+
+	config_usePreset(5);
+	memcpy(&saved, &g_cfg, sizeof(saved));
+	for (passes=0; passes < 1000; passes++) {
+		if (transaction(cmd, 5, 0xffff))
+			return -1;
+	}
+
+	config_usePreset(1);
+	if (config_load() || memcmp(&saved, &g_cfg, sizeof(saved))) {
+		printf("configuration not saved\n");
+		return -1;
+	}
+
+	config_erase();
+	for (passes=0; passes < 10; passes++)
+		mainLoop();
+	if (!config_load()) {
+		printf("configuration not erased\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* A 0x70 transaction with op, arg and n data bytes (zeros when data is
+ * NULL), after a main loop
+ * pass. Checks the header and the echo of a write. Returns the status
+ * byte, -1 on failure. */
+static int vendor(unsigned char op, unsigned char arg, const unsigned char *data, int n, unsigned char *reply)
+{
+	unsigned char cmd[MAX_LEN];
+	int len = 4 + n;
+
+	cmd[0] = 0x01;
+	cmd[1] = CMD_VENDOR_CONFIG_70;
+	cmd[2] = op;
+	cmd[3] = arg;
+	memset(cmd + 4, 0, n);
+	if (data)
+		memcpy(cmd + 4, data, n);
+
+	mainLoop();
+	hal_psx_transfer(cmd, reply, len);
+	ref_polls++;
+
+	if (reply[1] != g_cfg.deviceID || reply[2] != 0x5a)
+		return fail("wrong vendor reply header", cmd, NULL, NULL, len);
+	// Each reply echoes the previous byte
+	if (op == BUSCFG_OP_WRITE && memcmp(reply + 4, cmd + 3, n))
+		return fail("wrong write echo", cmd, NULL, NULL, len);
+
+	return reply[3];
+}
+
+/* Write img in chunks and commit it with sum. Returns the final status,
+ * -1 on failure. */
+static int upload(const unsigned char *img, unsigned char sum)
+{
+	unsigned char reply[MAX_LEN];
+	unsigned int pos, n;
+	int passes, status;
+
+	for (pos=0; pos<BUSCFG_IMAGE_SIZE; pos+=n) {
+		n = BUSCFG_IMAGE_SIZE - pos < 16 ? BUSCFG_IMAGE_SIZE - pos : 16;
+		if (vendor(BUSCFG_OP_WRITE, pos, img + pos, n, reply) < 0)
+			return -1;
+	}
+
+	// Read back before the commit
+	for (pos=0; pos<BUSCFG_IMAGE_SIZE; pos+=n) {
+		n = BUSCFG_IMAGE_SIZE - pos < 16 ? BUSCFG_IMAGE_SIZE - pos : 16;
+		if (vendor(BUSCFG_OP_READ, pos, NULL, n, reply) < 0)
+			return -1;
+		if (memcmp(reply + 4, img + pos, n)) {
+			printf("image differs from offset %u\n", pos);
+			return -1;
+		}
+	}
+
+	if (vendor(BUSCFG_OP_COMMIT, sum, NULL, 0, reply) < 0)
+		return -1;
+
+	for (passes=0; passes < 1000; passes++) {
+		status = vendor(BUSCFG_OP_STATUS, 0, NULL, 1, reply);
+		if (status != BUSCFG_BUSY)
+			return status;
+	}
+
+	printf("commit still busy\n");
+	return -1;
+}
+
+/* Uploads with 0x70: a bad sum and a bad image are rejected, a good one
+ * is applied and saved */
+static int buscfgTest(void)
+{
+	union {
+		struct adapter_config cfg;
+		unsigned char raw[BUSCFG_IMAGE_SIZE];
+	} img, before;
+	unsigned char sum = 0;
+	unsigned int i;
+
+	config_usePreset(1);
+	g_cfg.deviceID = DEVICE_ID_DIGITAL_PS1;
+	memcpy(&before.cfg, &g_cfg, sizeof(g_cfg));
+
+	memcpy(&img.cfg, &g_cfg, sizeof(g_cfg));
+	img.cfg.deviceID = DEVICE_ID_DUALSHOCK2;
+	img.cfg.preset = 0;
+	img.cfg.map[0].p = PSX_L2;
+	for (i=0; i<BUSCFG_IMAGE_SIZE; i++)
+		sum += img.raw[i];
+
+	if (upload(img.raw, sum + 1) != BUSCFG_ERROR || memcmp(&before.cfg, &g_cfg, sizeof(g_cfg))) {
+		printf("commit with a bad sum not rejected\n");
+		return -1;
+	}
+
+	// Passes the sum, not config_check()
+	img.cfg.map[1].analogByte = MAX_DS2_ANALOG_BUTTONS + 1;
+	if (upload(img.raw, sum + MAX_DS2_ANALOG_BUTTONS + 1 - before.cfg.map[1].analogByte) != BUSCFG_ERROR || memcmp(&before.cfg, &g_cfg, sizeof(g_cfg))) {
+		printf("bad image not rejected\n");
+		return -1;
+	}
+	img.cfg.map[1].analogByte = before.cfg.map[1].analogByte;
+
+	if (upload(img.raw, sum) != BUSCFG_OK || memcmp(&img.cfg, &g_cfg, sizeof(g_cfg))) {
+		printf("good image not applied\n");
+		return -1;
+	}
+
+	config_usePreset(1);
+	if (config_load() || memcmp(&img.cfg, &g_cfg, sizeof(g_cfg))) {
+		printf("good image not saved\n");
+		return -1;
+	}
+
+	config_usePreset(1);
+	g_cfg.deviceID = DEVICE_ID_DIGITAL_PS1;
+	return 0;
+}
+
+/* Polls a game with a known fingerprint, so profile 0 applies */
+static int profilePolls(void)
+{
+	unsigned char cmd[5] = { 0x01, 0x42, 0x40, 0x00, 0x00 };
+	int i;
+
+	gap();
+	// Einhander style polls, 3 bytes each
+	for (i=0; i<(FINGERPRINT_LEN + 2) / 3; i++) {
+		if (transaction(cmd, 5, 0xffff))
+			return -1;
+	}
+	mainLoop();
+
+	if (g_profile.match != 1 || g_cfg.deviceID != DEVICE_ID_DUALSHOCK2 || g_cfg.preset != 3) {
+		printf("profile not applied: match %d, device %02x, preset %d\n", g_profile.match, g_cfg.deviceID, g_cfg.preset);
+		return -1;
+	}
+	return 0;
+}
+
+/* A profile for a known fingerprint is applied, then undone by a gap.
+ * The map before is an unsaved edit, and the EEPROM holds nothing. A
+ * change made from the console while the profile is applied stays. */
+static int profileTest(void)
+{
+	struct map_ent base[NUM_MAP_ENTRIES + 1];
+	unsigned short crc = 0xffff;
+	int i;
+
+	config_erase();
+	for (i=0; i<10; i++)
+		mainLoop();
+
+	config_usePreset(1);
+	g_cfg.map[0].p = PSX_L2;
+	g_cfg.preset = 0;
+	g_map_serial++;
+	g_cfg.deviceID = DEVICE_ID_DIGITAL_PS1;
+	memcpy(base, g_cfg.map, sizeof(base));
+
+	for (i=0; i<FINGERPRINT_LEN; i++)
+		crc = crcCcitt(crc, i % 3 == 0 ? 0x42 : i % 3 == 1 ? 0x40 : 0x00);
+	g_cfg.profiles[0].fingerprint = crc;
+	g_cfg.profiles[0].deviceID = DEVICE_ID_DUALSHOCK2;
+	g_cfg.profiles[0].preset = 3;
+
+	if (profilePolls())
+		return -1;
+	gap();
+	if (g_cfg.deviceID != DEVICE_ID_DIGITAL_PS1 || g_cfg.preset != 0 || memcmp(base, g_cfg.map, sizeof(base))) {
+		printf("profile not undone: device %02x, preset %d\n", g_cfg.deviceID, g_cfg.preset);
+		return -1;
+	}
+
+	// As CONSOLE_CMD_USE_PRESET
+	if (profilePolls())
+		return -1;
+	config_usePreset(5);
+	memcpy(base, g_cfg.map, sizeof(base));
+	gap();
+	if (g_cfg.deviceID != DEVICE_ID_DIGITAL_PS1 || g_cfg.preset != 5 || memcmp(base, g_cfg.map, sizeof(base))) {
+		printf("console change undone: device %02x, preset %d\n", g_cfg.deviceID, g_cfg.preset);
+		return -1;
+	}
+
+	memset(&g_cfg.profiles[0], 0, sizeof(g_cfg.profiles[0]));
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iterations = 1000000;
+	unsigned short buttons = 0xffff;
+	int hold = 0;
+
+	if (argc > 1)
+		iterations = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		rnd = strtoul(argv[2], NULL, 0) | 1;
+
+	config_usePreset(1);
+	g_cfg.deviceID = DEVICE_ID_DIGITAL_PS1;
+	g_cfg.ack_delay = DEFAULT_ACK_DELAY;
+	g_cfg.ack_width = DEFAULT_ACK_WIDTH;
+	psx_init();
+	recorder_init();
+	buscfg_init();
+	profile_init(1);
+
+	rec[0].run = 0;
+	rec[0].b0 = 0xff;
+	rec[0].b1 = 0xff;
+	rec_count = 1;
+
+	for (iteration=0; iteration<iterations; iteration++) {
+		// Buttons are usually held for a few polls, sometimes with
+		// nothing else changing for longer than a recording entry counts
+		if (hold) {
+			hold--;
+		}
+		else {
+			randomChange();
+			if (nextRandom() % 1000 == 0)
+				hold = 256 + nextRandom() % 512;
+			else if (nextRandom() % 4 == 0)
+				buttons = nextRandom() | 0x000f;
+		}
+		if (nextRandom() % 500 == 0)
+			gap();
+		skipMainLoop = nextRandom() % 4 == 0;
+
+		if (randomTransaction(buttons))
+			return 1;
+		if (iteration % 256 == 0 && checkRecording())
+			return 1;
+	}
+
+	skipMainLoop = 0;
+	if (checkRecording() || recorderTest() || checkRecording() || saveTest() || buscfgTest() || profileTest())
+		return 1;
+
+	printf("%lu transactions passed\n", iterations);
+	return 0;
+}
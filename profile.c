@@ -0,0 +1,196 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "hal.h"
+#include "snes2ps.h"
+#include "config.h"
+#include "profile.h"
+#include "timer.h"
+
+volatile struct fingerprint g_fingerprint;
+struct profile_status g_profile;
+
+static unsigned char profile_enabled;
+
+/* Where the current fingerprint started, and when the last poll was
+ * seen (see PROFILE_REARM_MS) */
+static unsigned short startPolls;
+static unsigned short lastPolls;
+static unsigned short lastPollMs;
+static unsigned char idle;	// Re-armed, waiting for polls
+
+/* Settings before a profile was applied, and what the profile set. The
+ * console may change them while the profile is applied, rearm() then
+ * leaves them alone. */
+static unsigned char applied;
+static unsigned char baseDeviceID;
+static unsigned char basePreset;
+static struct map_ent baseMap[NUM_MAP_ENTRIES + 1];
+static unsigned char appliedDeviceID;
+static unsigned char appliedSerial;
+
+/* Known games. Add entries using the fingerprint reported by the
+ * console (CONSOLE_CMD_GET_FINGERPRINT) with the game running.
+ * Entries in g_cfg.profiles[] take precedence.
+ *
+ * Empty for now: no fingerprint has been taken from a real console with
+ * the current recording rules. */
+static const struct profile_ent builtin_profiles[] PROGMEM = {
+	{ 0, 0, 0 }, // End of table
+};
+
+static void apply(unsigned char deviceID, unsigned char preset)
+{
+	if (!profile_enabled)
+		return;
+
+	if (!applied) {
+		applied = 1;
+		baseDeviceID = g_cfg.deviceID;
+		basePreset = g_cfg.preset;
+		memcpy(baseMap, g_cfg.map, sizeof(baseMap));
+	}
+
+	if (preset) {
+		config_usePreset(preset);
+	}
+
+	if (deviceID) {
+		config_lock();
+		g_cfg.deviceID = deviceID;
+		config_unlock();
+	}
+
+	appliedSerial = g_map_serial;
+	appliedDeviceID = g_cfg.deviceID;
+}
+
+/* Undo apply() and start a new fingerprint */
+static void rearm(unsigned short polls)
+{
+	if (applied) {
+		applied = 0;
+
+		// As in config_apply(), the handler does not use the map
+		if (g_map_serial == appliedSerial) {
+			memcpy(g_cfg.map, baseMap, sizeof(g_cfg.map));
+			g_cfg.preset = basePreset;
+			g_map_serial++;
+		}
+
+		config_lock();
+		if (g_cfg.deviceID == appliedDeviceID)
+			g_cfg.deviceID = baseDeviceID;
+		config_unlock();
+	}
+
+	g_profile.done = 0;
+	g_profile.match = PROFILE_NO_MATCH;
+	startPolls = polls;
+
+	cli();
+	g_fingerprint.arg0 = 0;
+	g_fingerprint.pos = 0;
+	sei();
+}
+
+void profile_init(unsigned char enable)
+{
+	// Before sei(), and Timer2 was just started
+	profile_enabled = enable;
+	g_profile.done = 0;
+	g_profile.match = PROFILE_NO_MATCH;
+	g_fingerprint.arg0 = 0;
+	g_fingerprint.pos = 0;
+}
+
+static void lookup(unsigned short crc)
+{
+	unsigned char i, deviceID, preset;
+
+	for (i=0; i<NUM_PROFILES; i++) {
+		struct profile_ent *ent = &g_cfg.profiles[i];
+
+		if ((ent->deviceID || ent->preset) && ent->fingerprint == crc) {
+			g_profile.match = i + 1;
+			apply(ent->deviceID, ent->preset);
+			return;
+		}
+	}
+
+	for (i=0; ; i++) {
+		deviceID = pgm_read_byte(&builtin_profiles[i].deviceID);
+		preset = pgm_read_byte(&builtin_profiles[i].preset);
+
+		if (!deviceID && !preset)
+			break;
+
+		if (pgm_read_word(&builtin_profiles[i].fingerprint) == crc) {
+			g_profile.match = PROFILE_BUILTIN | i;
+			apply(deviceID, preset);
+			return;
+		}
+	}
+}
+
+void profile_poll(void)
+{
+	unsigned short crc = 0xffff;
+	unsigned short polls, now;
+	unsigned char i, len;
+
+	cli();
+	polls = g_counters.polls;
+	len = g_fingerprint.pos;
+	sei();
+	now = timer_ms();
+
+	if (polls != lastPolls) {
+		lastPolls = polls;
+		lastPollMs = now;
+		idle = 0;
+	}
+	else if (!idle && (unsigned short)(now - lastPollMs) >= PROFILE_REARM_MS) {
+		idle = 1;
+		rearm(polls);
+		return;
+	}
+
+	if (g_profile.done)
+		return;
+	if (len < FINGERPRINT_LEN && (unsigned short)(polls - startPolls) < PROFILE_POLLS)
+		return;
+
+	// Stop recording. The interrupt handler no longer writes to buf.
+	cli();
+	len = g_fingerprint.pos;
+	g_fingerprint.pos = FINGERPRINT_LEN;
+	sei();
+
+	for (i=0; i<len; i++)
+		crc = _crc_ccitt_update(crc, g_fingerprint.buf[i]);
+
+	g_profile.fingerprint = crc;
+	g_profile.len = len;
+	g_profile.done = 1;
+
+	// Standard polls only, nothing to tell this game from others
+	if (len)
+		lookup(crc);
+}
@@ -0,0 +1,113 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _profile_h__
+#define _profile_h__
+
+/* Automatic profile selection.
+ *
+ * Games do not all talk to the controller the same way. Most only send
+ * 01 42 00 00 00, but some send unusual bytes while reading the buttons
+ * (Einhander sends 0x40, Rollcage sends 0x01, DualShock games send their
+ * motor settings) and some try configuration commands (0x43...). Only
+ * these are recorded: the bytes following 0x42 when they are not 00 00
+ * (as 0x42 and the two bytes), and any command other than 0x42 or 0x70.
+ * The recorded bytes are hashed (CRC-CCITT) into a fingerprint, which is
+ * then looked up in g_cfg.profiles[] and in a built-in table.
+ *
+ * Configuration mode (0x43, 0x44, 0x45, 0x4D, 0x4F) is not answered: the
+ * command byte is not acknowledged, so the console gives up on the
+ * transaction and only that byte is recorded. Games that require it do
+ * not work with the adapter whatever the profile.
+ *
+ * The fingerprint is complete when FINGERPRINT_LEN bytes were recorded,
+ * or after PROFILE_POLLS polls. A game that only sends standard polls has
+ * nothing recorded and gets no profile. After PROFILE_REARM_MS without a
+ * poll (console reset, game changed), the settings a profile changed are
+ * restored from a copy taken when it was applied, unless the console
+ * changed them meanwhile, and a new fingerprint is taken.
+ *
+ * Use CONSOLE_CMD_GET_FINGERPRINT to find a game's fingerprint.
+ */
+#define FINGERPRINT_LEN	16
+
+#ifndef PROFILE_POLLS
+#define PROFILE_POLLS		600	// About 10 seconds
+#endif
+#ifndef PROFILE_REARM_MS
+#define PROFILE_REARM_MS	1000
+#endif
+
+struct fingerprint {
+	unsigned char pos;		// FINGERPRINT_LEN once complete
+	unsigned char arg0;		// Byte received with the 1st button byte
+	unsigned char buf[FINGERPRINT_LEN];
+};
+
+extern volatile struct fingerprint g_fingerprint;
+
+/* For the PSX interrupt handler: FINGERPRINT_CMD() with the 2nd byte
+ * when it is not 0x42 (or 0x70), FINGERPRINT_ARG0() and
+ * FINGERPRINT_ARG1() with the bytes received with the button bytes.
+ * Cost a compare or two for standard polls. */
+#ifdef WITH_PROFILES
+#define FINGERPRINT_PUT(c)	do { \
+		if (g_fingerprint.pos < FINGERPRINT_LEN) \
+			g_fingerprint.buf[g_fingerprint.pos++] = (c); \
+	} while(0)
+#define FINGERPRINT_CMD(c)	FINGERPRINT_PUT(c)
+#define FINGERPRINT_ARG0(c)	do { g_fingerprint.arg0 = (c); } while(0)
+#define FINGERPRINT_ARG1(c)	do { \
+		if (g_fingerprint.arg0 | (c)) { \
+			FINGERPRINT_PUT(0x42); \
+			FINGERPRINT_PUT(g_fingerprint.arg0); \
+			FINGERPRINT_PUT(c); \
+		} \
+	} while(0)
+#else
+#define FINGERPRINT_CMD(c)	do { } while(0)
+#define FINGERPRINT_ARG0(c)	do { } while(0)
+#define FINGERPRINT_ARG1(c)	do { } while(0)
+#endif
+
+#define PROFILE_NO_MATCH	0x00
+#define PROFILE_BUILTIN		0x80 // Ored with the built-in table index
+
+struct profile_status {
+	unsigned char done;			// Fingerprint complete and looked up
+	unsigned char len;			// Bytes recorded, 0 for standard polls only
+	unsigned char match;		// 1 to NUM_PROFILES, PROFILE_BUILTIN | n, or PROFILE_NO_MATCH
+	unsigned short fingerprint;
+};
+
+extern struct profile_status g_profile;
+
+#ifdef WITH_PROFILES
+/* When enable is 0 the fingerprint is still computed (for the console)
+ * but matching profiles are not applied. */
+void profile_init(unsigned char enable);
+
+/* Call from the main loop. Applies the matching profile once the
+ * fingerprint is complete, and re-arms it when polls stop. */
+void profile_poll(void);
+#else
+#define profile_init(enable)	do { } while(0)
+#define profile_poll()			do { } while(0)
+#endif
+
+#endif // _profile_h__
@@ -0,0 +1,553 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "hal.h"
+#include "snes2ps.h"
+#include "config.h"
+#include "buscfg.h"
+#include "profile.h"
+#include "recorder.h"
+#include "psx.h"
+
+#define CMD_BEGIN_01		0x01
+#define CMD_GET_DATA_42		0x42
+#define REP_DATA_START_5A	0x5a
+
+enum {
+  ST_IDLE = 0,
+  ST_READY,
+  ST_SEND_BUF0,
+  ST_SEND_BUF1,
+  ST_ANALOGSTICKS,
+  ST_ANALOGBUTTONS,
+  ST_VENDOR_OP,
+  ST_VENDOR_ARG,
+  ST_VENDOR_READ,
+  ST_VENDOR_WRITE,
+  ST_IGNORE,
+  ST_DONE
+};
+
+static unsigned char state = ST_IDLE;
+static volatile unsigned char psxbuf[2];
+static unsigned char numStickBytes = 0;
+static unsigned char numButtonBytes = 0;
+#ifdef WITH_BUSCFG
+static unsigned char vendorOp;
+#endif
+static unsigned char psxAnalogButtons[13];
+
+/* What the reply (psxbuf and psxAnalogButtons) was last built from.
+ * psx_poll() only rebuilds it when something changed. */
+#define DIRTY_BUTTONS	0x01 // Controller bits changed
+#define DIRTY_MAP		0x02 // g_cfg.map changed (g_map_serial)
+
+static unsigned char dirty;
+static unsigned short lastSnesbits;
+static unsigned char lastSerial;
+
+#ifdef WITH_LATE_SAMPLE
+/* Keeps the compiler from moving lateLut accesses across lateReady */
+#define barrier()	__asm__ __volatile__("" ::: "memory")
+
+/* Reply bytes for the current transaction: psxbuf, or lateBuf when
+ * the controller was read after 0x01. */
+static volatile unsigned char *txbuf = psxbuf;
+static unsigned char lateBuf[2];
+static volatile unsigned char lateClobbered;
+static volatile unsigned char lateReady;
+static unsigned short lateLut[4][16];
+#else
+#define txbuf psxbuf
+#endif
+
+volatile struct psx_counters g_counters;
+
+/* Ready for the next transaction */
+static inline void endTransaction(void)
+{
+	HAL_PSX_TX(0x00);
+	state = ST_IDLE;
+  numStickBytes = 4;
+  numButtonBytes = 0;
+}
+
+static void ack()
+{
+	HAL_DELAY_LOOP(g_cfg.ack_delay);
+
+	// pull acknowledge
+	HAL_PSX_ACK_LOW();
+
+	HAL_DELAY_LOOP(g_cfg.ack_width);
+
+	// release acknowledge
+	HAL_PSX_ACK_RELEASE();
+}
+
+/* 2nd byte of a transaction */
+static void handleReady(unsigned char cmd)
+{
+	if (cmd == CMD_GET_DATA_42) {
+		HAL_PSX_TX(0xff ^ REP_DATA_START_5A);
+		state = ST_SEND_BUF0;
+		ack();
+
+	}
+#ifdef WITH_BUSCFG
+	else if (cmd == CMD_VENDOR_CONFIG_70) {
+		HAL_PSX_TX(0xff ^ REP_DATA_START_5A);
+		state = ST_VENDOR_OP;
+		ack();
+	}
+#endif
+	else {
+		// Not answered, see profile.h. The other bytes are ignored.
+		HAL_PSX_TX(0x00);
+		FINGERPRINT_CMD(cmd);
+		state = ST_IGNORE;
+	}
+}
+
+#ifdef WITH_LATE_SAMPLE
+/* Latch pulse and clock half period of the late read, in us. The
+ * defaults suit a genuine 4021, which needs well under 1us. Clone pads
+ * built around a slower chip or a microcontroller may need more: build
+ * with, for instance, -DLATE_SAMPLE_CLOCK_US=1. Each us of half period
+ * adds 32us to the read, which then often misses the 3rd byte and the
+ * main loop sample is sent instead (see README). */
+#ifndef LATE_SAMPLE_LATCH_US
+#define LATE_SAMPLE_LATCH_US	1
+#endif
+#ifndef LATE_SAMPLE_CLOCK_US
+#define LATE_SAMPLE_CLOCK_US	0
+#endif
+
+/* Called from the interrupt handler once 0x01 is acknowledged. psxbuf[0]
+ * is only needed when the 3rd byte completes, so there is time to read
+ * the controller (about 25us with the default timing) and translate the
+ * result with lateLut. The 2nd byte is handled inline,
+ * as in ST_ANALOGSTICKS. If the 3rd byte completes first, the read is
+ * abandoned and the background sample in psxbuf is sent.
+ *
+ * Not done in DualShock 2 mode: the analog button bytes come from the
+ * background sample, and would not match the digital bits. */
+static void lateSample(void)
+{
+	unsigned char i;
+	unsigned short bits = 0;
+	unsigned short psxbits;
+
+	txbuf = psxbuf;
+	if (!lateReady || g_cfg.deviceID == DEVICE_ID_DUALSHOCK2)
+		return;
+	barrier();
+
+	// Whatever the main loop was reading is ruined
+	lateClobbered = 1;
+
+	SNES_LATCH_HIGH();
+	HAL_DELAY_US(LATE_SAMPLE_LATCH_US);
+	SNES_LATCH_LOW();
+
+	for (i=0; i<16; i++)
+	{
+		if (HAL_PSX_PENDING()) {
+			if (state != ST_READY)
+				return; // Too late
+			handleReady(HAL_PSX_RX());
+			if (state != ST_SEND_BUF0)
+				return;
+		}
+
+		SNES_CLOCK_LOW();
+#if LATE_SAMPLE_CLOCK_US
+		HAL_DELAY_US(LATE_SAMPLE_CLOCK_US);
+#endif
+		bits <<= 1;
+		if (SNES_GET_DATA())
+			bits |= 1;
+		SNES_CLOCK_HIGH();
+#if LATE_SAMPLE_CLOCK_US
+		HAL_DELAY_US(LATE_SAMPLE_CLOCK_US);
+#endif
+	}
+
+	bits = RECORDER_MASK(bits);
+	psxbits = lateLut[0][bits >> 12] & lateLut[1][(bits >> 8) & 0xf] &
+				lateLut[2][(bits >> 4) & 0xf] & lateLut[3][bits & 0xf];
+
+	lateBuf[0] = psxbits >> 8;
+	lateBuf[1] = psxbits & 0xff;
+	txbuf = lateBuf;
+}
+#endif
+
+HAL_PSX_HANDLER()
+{
+	unsigned char cmd;
+
+	cmd = HAL_PSX_RX();
+
+	switch(state)
+	{
+		case ST_IDLE: // Expecting 0x01
+			if (cmd != CMD_BEGIN_01) {
+				/* First byte is no 0x01? This is not a message for us (probably memory card)
+				 *
+				 * Ignore all other bytes until Slave Select is deasserted.
+				 * One interrupt per byte rather than a loop here, so the
+				 * USART is still served during long memory card transfers.
+				 */
+				g_counters.ignored++;
+				HAL_PSX_TX(0x00); // dont pull the bus low (sends 0xff)
+				state = ST_IGNORE;
+			}
+			else {
+				// Prepare the Device ID (default is 0x41)
+				HAL_PSX_TX(0xff ^ g_cfg.deviceID);
+				state = ST_READY;
+				ack();
+				g_counters.polls++;
+#ifdef WITH_LATE_SAMPLE
+				lateSample();
+#endif
+			}
+			break;
+
+		case ST_READY: // Expecting 0x42
+			handleReady(cmd);
+			break;
+
+			// Based on Playstation.txt, I initially understood that the Playstation
+			// would always send 0x00 when reading the button status and wrote code
+			// that checked the received values.
+			//
+			// However, Einhander sends 0x40:
+			//  Game...: 0x01, 0x42, 0x00, 0x40,   0x00
+			//  Adapter: 0xFF, 0x41, 0x5a, dat[0], dat[1]
+			//
+			// And rollcage sends a 0x01:
+			//  Game...: 0x01, 0x42, 0x01, 0x00,   0x00
+			//  Adapter: 0xFF, 0x41, 0x5a, dat[0], dat[1]
+			//
+			// The unexpected values above prevented the games from working, so
+			// I now treat the transmitted values during button status as "don't care"
+			// rather than "expecting 0".
+			//
+			// This seems to be working well.
+			//
+		case ST_SEND_BUF0: // start of data 0x5a sent
+				HAL_PSX_TX(0xff ^ txbuf[0]);
+				state = ST_SEND_BUF1;
+				ack();
+				FINGERPRINT_ARG0(cmd);
+				RECORDER_SENT0(txbuf[0]);
+				break;
+
+		case ST_SEND_BUF1: // psxbuf[0] sent
+				HAL_PSX_TX(0xff ^ txbuf[1]);
+        if (g_cfg.deviceID == DEVICE_ID_DUALSHOCK2) state = ST_ANALOGSTICKS;
+        else state = ST_DONE;
+				ack();
+				FINGERPRINT_ARG1(cmd);
+				RECORDER_SENT1(txbuf[1]);
+				break;
+
+    case ST_ANALOGSTICKS: // psxbuf[1] sent, faking DualShock 2 sticks
+				HAL_PSX_TX(0xFF ^ DS2_STICK_CENTERED); // Sends 0x7F (default value for DS2 sticks)
+        numStickBytes--;
+        ack();
+        // Attention is checked so an aborted transaction cannot
+        // keep us here.
+        while (numStickBytes && CHIP_SELECT_ACTIVE()) {
+          if (HAL_PSX_PENDING()) {
+            numStickBytes--;
+            HAL_PSX_TX(0xFF ^ DS2_STICK_CENTERED); // Send another 0x7F
+            ack();
+          }
+        }
+        state = ST_ANALOGBUTTONS;
+				break;
+
+    case ST_ANALOGBUTTONS: // Fake stick data sent, faking DualShock 2 analog buttons by sending either 0x00 or 0xFF
+				HAL_PSX_TX(0xFF ^ psxAnalogButtons[0]);
+        numButtonBytes++;
+        ack();
+        while (numButtonBytes < 12 && CHIP_SELECT_ACTIVE()) {
+          if (HAL_PSX_PENDING()) {
+            HAL_PSX_TX(0xFF ^ psxAnalogButtons[numButtonBytes]);
+            numButtonBytes++;
+            ack();
+          }
+        }
+        state = ST_DONE;
+				break;
+
+#ifdef WITH_BUSCFG
+			// Configuration upload, see buscfg.h. Only bytes are stored here,
+			// the image is checked and saved from the main loop.
+		case ST_VENDOR_OP: // 0x5a sent
+				vendorOp = cmd;
+				HAL_PSX_TX(0xff ^ g_buscfg.status);
+				state = ST_VENDOR_ARG;
+				ack();
+				break;
+
+		case ST_VENDOR_ARG: // status sent
+				switch (vendorOp)
+				{
+					case BUSCFG_OP_READ:
+						if (cmd < BUSCFG_IMAGE_SIZE)
+							HAL_PSX_TX(0xff ^ g_buscfg.image.raw[cmd++]);
+						else
+							HAL_PSX_TX(0x00);
+						g_buscfg.pos = cmd;
+						state = ST_VENDOR_READ;
+						break;
+
+					case BUSCFG_OP_WRITE:
+						g_buscfg.editing = 1;
+						g_buscfg.pos = cmd;
+						HAL_PSX_TX(0xff ^ cmd);
+						state = ST_VENDOR_WRITE;
+						break;
+
+					case BUSCFG_OP_COMMIT:
+						if (g_buscfg.status != BUSCFG_BUSY) {
+							g_buscfg.sum = cmd;
+							g_buscfg.status = BUSCFG_BUSY;
+						}
+						HAL_PSX_TX(0x00);
+						state = ST_DONE;
+						break;
+
+					default:
+						HAL_PSX_TX(0xff ^ BUSCFG_IMAGE_SIZE);
+						state = ST_DONE;
+						break;
+				}
+				ack();
+				break;
+
+		case ST_VENDOR_READ:
+				if (g_buscfg.pos < BUSCFG_IMAGE_SIZE)
+					HAL_PSX_TX(0xff ^ g_buscfg.image.raw[g_buscfg.pos++]);
+				else
+					HAL_PSX_TX(0x00);
+				ack();
+				break;
+
+		case ST_VENDOR_WRITE:
+				if (g_buscfg.pos < BUSCFG_IMAGE_SIZE && g_buscfg.status != BUSCFG_BUSY)
+					g_buscfg.image.raw[g_buscfg.pos++] = cmd;
+				HAL_PSX_TX(0xff ^ cmd);
+				ack();
+				break;
+#endif
+
+		case ST_IGNORE: // Someone else's transaction
+				HAL_PSX_TX(0x00);
+				break;
+
+		case ST_DONE: // All data sent
+				HAL_PSX_TX(0x00); // dont pull the bus low (send 0xff)
+				state = ST_IDLE;
+				break;
+	}
+
+	// Last byte of the transaction, see HAL_PSX_ATTN_HANDLER() below
+	if (!CHIP_SELECT_ACTIVE())
+		endTransaction();
+}
+
+/* Attention deasserted: the transaction is over, whoever it was for and
+ * however far it got. If a last byte is still waiting, the byte handler
+ * runs next and sees attention deasserted itself. */
+HAL_PSX_ATTN_HANDLER()
+{
+	if (!HAL_PSX_PENDING())
+		endTransaction();
+}
+
+unsigned short snes_read(void)
+{
+	int i,j;
+	unsigned char tmp=0;
+	unsigned short bits=0;
+
+	SNES_LATCH_HIGH();
+	HAL_DELAY_US(12);
+	SNES_LATCH_LOW();
+
+	for (j=0; j<2; j++)
+	{
+		for (i=0; i<8; i++)
+		{
+			HAL_DELAY_US(6);
+			SNES_CLOCK_LOW();
+
+			tmp <<= 1;
+			if (SNES_GET_DATA())
+				tmp |= 1;
+
+			HAL_DELAY_US(6);
+
+			SNES_CLOCK_HIGH();
+		}
+		bits = (bits << 8) | tmp;
+	}
+
+	return bits;
+}
+
+/* Release the analog bytes no map entry drives any more, after the
+ * map changed. */
+static void clearUnmappedAnalog(void)
+{
+	unsigned short used = 0;
+	unsigned char i;
+
+	for (i=0; g_cfg.map[i].s; i++)
+		used |= 1 << g_cfg.map[i].analogByte;
+
+	for (i=0; i<MAX_DS2_ANALOG_BUTTONS; i++) {
+		if (!(used & (1 << i)))
+			psxAnalogButtons[i] = DS2_ANALOG_BUTTON_UNPRESSED;
+	}
+}
+
+unsigned short snes2psx(unsigned short snesbits)
+{
+	unsigned short psxval;
+	int i;
+	struct map_ent *map = g_cfg.map;
+
+	/* Start with a ALL ones message and
+	 * clear the bits when needed. */
+	psxval = 0xffff;
+
+	for (i=0; map[i].s; i++) {
+		if (!(snesbits & map[i].s)) {
+			psxval &= ~(map[i].p);
+      psxAnalogButtons[map[i].analogByte] = DS2_ANALOG_BUTTON_PRESSED;
+    }
+    else
+    {
+      psxAnalogButtons[map[i].analogByte] = DS2_ANALOG_BUTTON_UNPRESSED;
+    }
+	}
+
+	return psxval;
+}
+
+#ifdef WITH_LATE_SAMPLE
+/* The translation done by snes2psx() for each nibble of the controller
+ * bits, the others being released. ANDing the 4 results gives the same
+ * PSX bits, in a few cycles. */
+static void lateBuildLut(void)
+{
+	unsigned char n, v, i;
+	unsigned short snesbits, psxbits;
+	struct map_ent *map = g_cfg.map;
+
+	lateReady = 0;
+	barrier();
+
+	for (n=0; n<4; n++) {
+		for (v=0; v<16; v++) {
+			snesbits = ~(0xf000 >> (n*4)) | (v << (12 - n*4));
+			psxbits = 0xffff;
+			for (i=0; map[i].s; i++) {
+				if (!(snesbits & map[i].s))
+					psxbits &= ~(map[i].p);
+			}
+			lateLut[n][v] = psxbits;
+		}
+	}
+
+	barrier();
+	lateReady = 1;
+}
+#endif
+
+void psx_init(void)
+{
+	// buttons are active low and reserved bits stay high.
+	psxbuf[0] = 0xff;
+	psxbuf[1] = 0xff;
+
+	memset(psxAnalogButtons, DS2_ANALOG_BUTTON_UNPRESSED, 12);
+
+	dirty = DIRTY_BUTTONS | DIRTY_MAP;
+	lastSerial = g_map_serial;
+
+#ifdef WITH_LATE_SAMPLE
+	lateBuildLut();
+#endif
+
+	endTransaction();
+}
+
+unsigned short psx_poll(void)
+{
+	unsigned short psxbits;
+	unsigned short snesbits;
+
+	if (lastSerial != g_map_serial) {
+		lastSerial = g_map_serial;
+		dirty |= DIRTY_MAP;
+#ifdef WITH_LATE_SAMPLE
+		lateBuildLut();
+#endif
+	}
+
+#ifdef WITH_LATE_SAMPLE
+	lateClobbered = 0;
+#endif
+
+	snesbits = snes_read();
+
+	if (snesbits != lastSnesbits) {
+		lastSnesbits = snesbits;
+		dirty |= DIRTY_BUTTONS;
+	}
+
+#ifdef WITH_LATE_SAMPLE
+	// The interrupt handler used the controller during the read. Stays
+	// dirty, the next pass will do.
+	if (lateClobbered)
+		return snesbits;
+#endif
+
+	// Nearly every pass, buttons are rarely pressed or released
+	// between two reads.
+	if (!dirty)
+		return snesbits;
+
+	psxbits = snes2psx(RECORDER_MASK(snesbits));
+	if (dirty & DIRTY_MAP)
+		clearUnmappedAnalog();
+	dirty = 0;
+
+	psxbuf[0] = psxbits >> 8;
+	psxbuf[1] = psxbits & 0xff;
+
+	return snesbits;
+}
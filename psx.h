@@ -0,0 +1,49 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _psx_h__
+#define _psx_h__
+
+/* The controller side of the PSX protocol and the SNES to PSX button
+ * translation. Only uses the hardware through hal.h, so the same code
+ * runs on the adapter and on a PC (see host/).
+ *
+ * The per-byte handler (the SPI interrupt on the AVR) is defined here
+ * with HAL_PSX_HANDLER(), and the end of transaction handler (attention
+ * deasserted) with HAL_PSX_ATTN_HANDLER(). Between them they get ready
+ * for the next transaction without help from the main loop, which may
+ * be busy for any length of time. */
+
+/* Set the replies to "nothing pressed" and get ready for the first
+ * transaction. Call once g_cfg is set up, before the handlers may run. */
+void psx_init(void);
+
+/* Call from the main loop. Reads the controller and updates the
+ * reply for the next transaction. Returns the controller bits, as
+ * snes_read(). */
+unsigned short psx_poll(void);
+
+/* Read the controller. Returns the 16 bits in the received order
+ * (see SNES_* in snes2ps.h), 0 meaning pressed. */
+unsigned short snes_read(void);
+
+/* Translate controller bits with g_cfg.map. Returns the PSX bits (0
+ * meaning pressed) and updates the DualShock 2 analog button bytes. */
+unsigned short snes2psx(unsigned short snesbits);
+
+#endif // _psx_h__
@@ -0,0 +1,182 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stddef.h>
+#include "hal.h"
+#include "snes2ps.h"
+#include "config.h"
+#include "recorder.h"
+#include "timer.h"
+
+#if RECORDER_SIZE > 255
+#error RECORDER_SIZE must fit in a byte
+#endif
+
+#define RECORDER_MAGIC	0x5E01
+
+struct eeprom_recording {
+	unsigned short magic;
+	unsigned char head;
+	unsigned char wrapped;
+	struct rec_ent ent[RECORDER_SIZE];
+};
+
+#define ee_rec	(*(struct eeprom_recording *)HAL_EEPROM(EE_RECORDER_ADDR))
+
+// Fails to compile if RECORDER_SIZE does not fit in this chip's EEPROM
+typedef char ee_rec_fits[EE_RECORDER_ADDR + sizeof(struct eeprom_recording) <= HAL_EEPROM_SIZE ? 1 : -1];
+
+volatile struct recorder g_recorder;
+
+static unsigned char chord_held;
+static unsigned short chord_start;
+static unsigned short freeze_ms;
+
+/* Next byte of a save: ee_rec, then its magic again once the rest is
+ * written. */
+static unsigned short save_pos;
+#define SAVE_STEPS	(sizeof(struct eeprom_recording) + sizeof(ee_rec.magic))
+
+void recorder_init(void)
+{
+	g_recorder.head = 0;
+	g_recorder.wrapped = 0;
+
+	// Nothing pressed yet. run is 0 until the first poll.
+	g_recorder.ent[0].run = 0;
+	g_recorder.ent[0].b0 = 0xff;
+	g_recorder.ent[0].b1 = 0xff;
+
+	g_recorder.frozen = 0;
+}
+
+unsigned char recorder_count(unsigned char saved)
+{
+	if (saved) {
+		if (eeprom_read_word(&ee_rec.magic) != RECORDER_MAGIC)
+			return 0;
+		if (eeprom_read_byte(&ee_rec.wrapped))
+			return RECORDER_SIZE;
+		return eeprom_read_byte(&ee_rec.head) + 1;
+	}
+
+	return g_recorder.wrapped ? RECORDER_SIZE : g_recorder.head + 1;
+}
+
+void recorder_get(unsigned char saved, unsigned char i, struct rec_ent *dst)
+{
+	unsigned short idx = i;
+
+	if (saved) {
+		if (eeprom_read_byte(&ee_rec.wrapped))
+			idx += eeprom_read_byte(&ee_rec.head) + 1;
+		if (idx >= RECORDER_SIZE)
+			idx -= RECORDER_SIZE;
+		eeprom_read_block(dst, &ee_rec.ent[idx], sizeof(struct rec_ent));
+		return;
+	}
+
+	if (g_recorder.wrapped)
+		idx += g_recorder.head + 1;
+	if (idx >= RECORDER_SIZE)
+		idx -= RECORDER_SIZE;
+	dst->run = g_recorder.ent[idx].run;
+	dst->b0 = g_recorder.ent[idx].b0;
+	dst->b1 = g_recorder.ent[idx].b1;
+}
+
+void recorder_freeze(void)
+{
+	g_recorder.frozen |= RECORDER_FROZEN_READ;
+	freeze_ms = timer_ms();
+}
+
+void recorder_save(void)
+{
+	if (g_recorder.frozen & RECORDER_FROZEN_SAVE)
+		return;
+
+	save_pos = 0;
+	g_recorder.frozen |= RECORDER_FROZEN_SAVE;
+}
+
+/* Write one byte of ee_rec, when the EEPROM is not busy with the last
+ * one. The magic is invalid until the rest is written. */
+static void saveStep(void)
+{
+	unsigned char *dst = (unsigned char *)&ee_rec + save_pos;
+	unsigned char val;
+
+	if (!eeprom_is_ready())
+		return;
+
+	if (save_pos < sizeof(ee_rec.magic)) {
+		val = 0xff;
+	}
+	else if (save_pos == offsetof(struct eeprom_recording, head)) {
+		val = g_recorder.head;
+	}
+	else if (save_pos == offsetof(struct eeprom_recording, wrapped)) {
+		val = g_recorder.wrapped;
+	}
+	else if (save_pos < sizeof(ee_rec)) {
+		val = ((volatile unsigned char *)g_recorder.ent)[save_pos - offsetof(struct eeprom_recording, ent)];
+	}
+	else {
+		// Little endian, as eeprom_read_word()
+		dst = (unsigned char *)&ee_rec.magic + save_pos - sizeof(ee_rec);
+		val = RECORDER_MAGIC >> ((save_pos - sizeof(ee_rec)) * 8);
+	}
+
+	eeprom_update_byte(dst, val);
+
+	if (++save_pos == SAVE_STEPS)
+		g_recorder.frozen &= ~RECORDER_FROZEN_SAVE;
+}
+
+void recorder_poll(unsigned short snesbits)
+{
+	unsigned short polls;
+
+	if (g_recorder.frozen & RECORDER_FROZEN_SAVE)
+		saveStep();
+
+	if ((g_recorder.frozen & RECORDER_FROZEN_READ) &&
+			(unsigned short)(timer_ms() - freeze_ms) >= RECORDER_READ_TIMEOUT_MS)
+		recorder_resume();
+
+	// Buttons are active low
+	if (snesbits & RECORDER_CHORD) {
+		chord_held = 0;
+		return;
+	}
+
+	cli();
+	polls = g_counters.polls;
+	sei();
+
+	if (!chord_held) {
+		chord_held = 1;
+		chord_start = polls;
+	}
+	else if (chord_held == 1 && (unsigned short)(polls - chord_start) >= RECORDER_CHORD_POLLS) {
+		// Once per press
+		chord_held = 2;
+		recorder_save();
+	}
+}
@@ -0,0 +1,123 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _recorder_h__
+#define _recorder_h__
+
+/* Record of the button bytes actually sent to the console.
+ *
+ * Each entry is a button word and the number of consecutive polls it
+ * was sent for (1 to 255), so a ring of RECORDER_SIZE entries covers
+ * RECORDER_SIZE changes, and at least RECORDER_SIZE polls. A poll that
+ * sends the same word as the previous one only increments the count.
+ *
+ * Holding RECORDER_CHORD for RECORDER_CHORD_POLLS polls copies the ring
+ * to EEPROM, where it stays until the next save. Both can be read with
+ * CONSOLE_CMD_READ_RECORDING. The game does not see the chord while all
+ * its buttons are held (see RECORDER_MASK()), only the ones pressed
+ * before the last.
+ */
+#ifndef RECORDER_SIZE
+#define RECORDER_SIZE	96
+#endif
+
+// Select + Start + L + R, for about 2 seconds
+#define RECORDER_CHORD			(SNES_SELECT | SNES_START | SNES_L | SNES_R)
+#define RECORDER_CHORD_POLLS	120
+
+// A console read of the live ring stopped halfway
+#define RECORDER_READ_TIMEOUT_MS	2000
+
+// g_recorder.frozen
+#define RECORDER_FROZEN_SAVE	0x01 // Being copied to EEPROM
+#define RECORDER_FROZEN_READ	0x02 // Being read by the console
+
+struct rec_ent {
+	unsigned char run;	// Polls this word was sent for. 0 in unused entries.
+	unsigned char b0;	// Button bytes as sent (0 = pressed)
+	unsigned char b1;
+};
+
+struct recorder {
+	unsigned char frozen;	// Not recording when non-zero, RECORDER_FROZEN_*
+	unsigned char head;		// Newest entry
+	unsigned char wrapped;	// Entries after head are older ones
+	unsigned char b0;		// First button byte of the current poll
+	struct rec_ent ent[RECORDER_SIZE];
+};
+
+extern volatile struct recorder g_recorder;
+
+#ifdef WITH_RECORDER
+/* For the PSX interrupt handler, when each button byte is sent. Costs a
+ * compare and one or two stores per poll while the buttons are held,
+ * 4 stores when they change. */
+#define RECORDER_SENT0(c)	do { g_recorder.b0 = (c); } while(0)
+#define RECORDER_SENT1(c)	do { \
+		if (!g_recorder.frozen) { \
+			volatile struct rec_ent *e = &g_recorder.ent[g_recorder.head]; \
+			if (e->b0 == g_recorder.b0 && e->b1 == (c) && e->run != 0xff) { \
+				e->run++; \
+			} else { \
+				if (++g_recorder.head == RECORDER_SIZE) { \
+					g_recorder.head = 0; \
+					g_recorder.wrapped = 1; \
+				} \
+				e = &g_recorder.ent[g_recorder.head]; \
+				e->b0 = g_recorder.b0; \
+				e->b1 = (c); \
+				e->run = 1; \
+			} \
+		} \
+	} while(0)
+
+/* Controller bits with the chord released while all of it is held, for
+ * the reply. */
+#define RECORDER_MASK(snesbits)	(((snesbits) & RECORDER_CHORD) ? (snesbits) : ((snesbits) | RECORDER_CHORD))
+
+void recorder_init(void);
+
+/* Call from the main loop with the controller bits. Watches for
+ * RECORDER_CHORD and writes the next EEPROM byte of a save. */
+void recorder_poll(unsigned short snesbits);
+
+/* Stop recording while the console reads the live ring. Recording
+ * resumes with recorder_resume(), or RECORDER_READ_TIMEOUT_MS later. */
+void recorder_freeze(void);
+#define recorder_resume()	do { g_recorder.frozen &= ~RECORDER_FROZEN_READ; } while(0)
+
+/* Number of entries in the live (saved is 0) or saved (saved is 1)
+ * recording. */
+unsigned char recorder_count(unsigned char saved);
+
+/* Copy entry i (0 is the oldest) of the live or saved recording.
+ * Read the live one while frozen. */
+void recorder_get(unsigned char saved, unsigned char i, struct rec_ent *dst);
+
+/* Start copying the ring to EEPROM, one byte per recorder_poll().
+ * Recording stops until it is done, about a second later. */
+void recorder_save(void);
+#else
+#define RECORDER_MASK(snesbits)	(snesbits)
+#define RECORDER_SENT0(c)		do { } while(0)
+#define RECORDER_SENT1(c)		do { } while(0)
+#define recorder_init()			do { } while(0)
+#define recorder_poll(snesbits)	do { (void)(snesbits); } while(0)
+#endif
+
+#endif // _recorder_h__
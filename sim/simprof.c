@@ -0,0 +1,538 @@
+/*
+    simprof: cycle profiler for the snes2psx firmware under simavr
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Runs the firmware with a simulated console polling the controller port
+ * and a simulated SNES controller, and attributes every cycle to the call
+ * stack executing it. The output is in the "folded" format accepted by
+ * flamegraph.pl:
+ *
+ *   __ctors_end;main;psx_poll;snes_read;_delay 1234567
+ *
+ * Symbols come from "avr-nm -n" output (see Makefile). The call stack is
+ * tracked from call/ret instructions and interrupt entries. Inlined code
+ * such as _delay_us() has no symbol of its own, so the busy loops it
+ * expands to (dec/sbiw followed by "brne .-4", nop, "rjmp .+0") are shown
+ * as a _delay frame under the function containing them.
+ *
+ * A summary goes to stderr: the cycles the CPU was awake per poll (all
+ * but [sleep]), and the functions taking the most cycles per poll,
+ * including their callees. Cycles spent waiting in a loop count as awake,
+ * so compare functions rather than the total when the main loop spins.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_cycle_timers.h"
+#include "sim_time.h"
+#include "avr_ioport.h"
+#include "avr_spi.h"
+
+#define MAX_SYMBOLS		1024
+#define MAX_DEPTH		16
+#define HASH_SIZE		4096
+#define SUMMARY_TOP		12
+
+struct symbol {
+	unsigned long addr; // bytes
+	char name[64];
+};
+
+struct sample {
+	unsigned char depth;
+	short frames[MAX_DEPTH + 2]; // + leaf and _delay
+	unsigned long long cycles;
+};
+
+static struct symbol symbols[MAX_SYMBOLS];
+static int num_symbols;
+static unsigned long vectors_end;
+
+static short stack[MAX_DEPTH];
+static int depth;
+
+static struct sample samples[HASH_SIZE];
+
+#define FRAME_DELAY		-2
+#define FRAME_SLEEP		-3
+#define FRAME_UNKNOWN	-1
+
+/******** Symbols **************/
+
+static int loadSymbols(const char *filename)
+{
+	FILE *fptr;
+	char line[256], type, name[sizeof(symbols[0].name)];
+	unsigned long addr;
+	const char *vec_end_names[] = { "__trampolines_start", "__ctors_start", "__ctors_end", "__init", NULL };
+	int i;
+
+	fptr = fopen(filename, "r");
+	if (!fptr) {
+		perror(filename);
+		return -1;
+	}
+
+	vectors_end = 0x68;
+	while (fgets(line, sizeof(line), fptr)) {
+		if (sscanf(line, "%lx %c %63s", &addr, &type, name) != 3)
+			continue;
+
+		for (i=0; vec_end_names[i]; i++) {
+			if (!strcmp(name, vec_end_names[i]) && addr < vectors_end)
+				vectors_end = addr;
+		}
+
+		if (type != 'T' && type != 't')
+			continue;
+		if (num_symbols == MAX_SYMBOLS)
+			break;
+
+		symbols[num_symbols].addr = addr;
+		// Same size, sscanf() cut longer names and terminated them
+		memcpy(symbols[num_symbols].name, name, sizeof(name));
+		num_symbols++;
+	}
+
+	fclose(fptr);
+
+	return num_symbols ? 0 : -1;
+}
+
+/* avr-nm -n output is sorted by address */
+static short symbolAt(unsigned long pc)
+{
+	int lo = 0, hi = num_symbols - 1, mid;
+
+	if (!num_symbols || pc < symbols[0].addr)
+		return FRAME_UNKNOWN;
+
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (symbols[mid].addr <= pc)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
+static const char *frameName(short f)
+{
+	switch (f)
+	{
+		case FRAME_DELAY: return "_delay";
+		case FRAME_SLEEP: return "[sleep]";
+		case FRAME_UNKNOWN: return "[unknown]";
+	}
+	return symbols[f].name;
+}
+
+/******** Cycle attribution **********/
+
+static void account(short leaf, short extra, unsigned long long cycles)
+{
+	short frames[MAX_DEPTH + 2];
+	unsigned char n = 0;
+	unsigned long h = 5381;
+	int i;
+
+	for (i=0; i<depth && i<MAX_DEPTH; i++)
+		frames[n++] = stack[i];
+	if (!n || frames[n-1] != leaf)
+		frames[n++] = leaf;
+	if (extra)
+		frames[n++] = extra;
+
+	for (i=0; i<n; i++)
+		h = h * 33 + (unsigned short)frames[i];
+
+	for (i=0; i<HASH_SIZE; i++) {
+		struct sample *s = &samples[(h + i) % HASH_SIZE];
+
+		if (!s->cycles) {
+			s->depth = n;
+			memcpy(s->frames, frames, n * sizeof(short));
+		}
+		else if (s->depth != n || memcmp(s->frames, frames, n * sizeof(short))) {
+			continue;
+		}
+		s->cycles += cycles;
+		return;
+	}
+
+	fprintf(stderr, "Too many distinct stacks\n");
+	exit(1);
+}
+
+static void push(short f)
+{
+	if (depth < MAX_DEPTH)
+		stack[depth] = f;
+	depth++;
+}
+
+static void pop(void)
+{
+	if (depth)
+		depth--;
+}
+
+static unsigned short opcodeAt(avr_t *avr, unsigned long pc)
+{
+	return avr->flash[pc] | (avr->flash[pc + 1] << 8);
+}
+
+/* Target of the rjmp or jmp in an interrupt vector slot */
+static unsigned long vectorTarget(avr_t *avr, unsigned long slot)
+{
+	unsigned short op = opcodeAt(avr, slot);
+
+	if ((op & 0xF000) == 0xC000) { // rjmp
+		short k = op & 0x0FFF;
+		if (k & 0x800)
+			k |= 0xF000;
+		return slot + 2 + k * 2;
+	}
+	if ((op & 0xFE0E) == 0x940C) { // jmp
+		unsigned long k = ((op & 0x01F0) << 13) | ((op & 1) << 16) | opcodeAt(avr, slot + 2);
+		return k * 2;
+	}
+	return slot;
+}
+
+static unsigned long callTarget(avr_t *avr, unsigned long pc, unsigned short op)
+{
+	if ((op & 0xF000) == 0xD000) { // rcall
+		short k = op & 0x0FFF;
+		if (k & 0x800)
+			k |= 0xF000;
+		return pc + 2 + k * 2;
+	}
+	if ((op & 0xFE0E) == 0x940E) { // call
+		unsigned long k = ((op & 0x01F0) << 13) | ((op & 1) << 16) | opcodeAt(avr, pc + 2);
+		return k * 2;
+	}
+	// icall, eicall (EIND ignored, the targets are below 128K)
+	return (avr->data[30] | (avr->data[31] << 8)) * 2;
+}
+
+static int isDelayLoop(avr_t *avr, unsigned long pc, unsigned short op)
+{
+	if (op == 0x0000 || op == 0xC000) // nop, rjmp .+0
+		return 1;
+	if (op == 0xF7F1) // brne .-4
+		return 1;
+	return opcodeAt(avr, pc + 2) == 0xF7F1;
+}
+
+static void step(avr_t *avr)
+{
+	unsigned long pc = avr->pc;
+	unsigned short op = opcodeAt(avr, pc);
+	unsigned long target = 0;
+	avr_cycle_count_t before = avr->cycle;
+	int was_sleeping = avr->state == cpu_Sleeping;
+	int is_call = (op & 0xF000) == 0xD000 || (op & 0xFE0E) == 0x940E ||
+					op == 0x9509 || op == 0x9519;
+
+	if (is_call)
+		target = callTarget(avr, pc, op);
+
+	avr_run(avr);
+
+	if (was_sleeping) {
+		account(symbolAt(pc), FRAME_SLEEP, avr->cycle - before);
+	} else {
+		account(symbolAt(pc), isDelayLoop(avr, pc, op) ? FRAME_DELAY : 0, avr->cycle - before);
+	}
+
+	if (!was_sleeping && is_call) {
+		// An interrupt may also have been taken right after, it is
+		// handled below.
+		push(symbolAt(target));
+	}
+	else if (!was_sleeping && (op == 0x9508 || op == 0x9518)) { // ret, reti
+		pop();
+	}
+
+	if (avr->pc && avr->pc < vectors_end) {
+		// Interrupt entry
+		push(symbolAt(vectorTarget(avr, avr->pc)));
+	}
+}
+
+static void printProfile(FILE *out, unsigned long long *total)
+{
+	int i, j;
+
+	*total = 0;
+	for (i=0; i<HASH_SIZE; i++) {
+		if (!samples[i].cycles)
+			continue;
+		for (j=0; j<samples[i].depth; j++)
+			fprintf(out, "%s%s", j ? ";" : "", frameName(samples[i].frames[j]));
+		fprintf(out, " %llu\n", samples[i].cycles);
+		*total += samples[i].cycles;
+	}
+}
+
+static unsigned long long inclusive[MAX_SYMBOLS];
+
+static int byInclusive(const void *a, const void *b)
+{
+	unsigned long long ca = inclusive[*(const short *)a];
+	unsigned long long cb = inclusive[*(const short *)b];
+
+	return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+/* Awake cycles per poll, and the SUMMARY_TOP functions by cycles per
+ * poll, callees included. */
+static void printSummary(FILE *out, unsigned long long total, unsigned long polls)
+{
+	static short order[MAX_SYMBOLS];
+	unsigned long long asleep = 0;
+	int i, j, k;
+
+	for (i=0; i<HASH_SIZE; i++) {
+		struct sample *s = &samples[i];
+
+		if (!s->cycles)
+			continue;
+		if (s->frames[s->depth - 1] == FRAME_SLEEP) {
+			asleep += s->cycles;
+			continue;
+		}
+		for (j=0; j<s->depth; j++) {
+			if (s->frames[j] < 0)
+				continue;
+			// Once per stack, in case of recursion
+			for (k=0; k<j && s->frames[k] != s->frames[j]; k++) { }
+			if (k == j)
+				inclusive[s->frames[j]] += s->cycles;
+		}
+	}
+
+	fprintf(out, "%llu cycles, %llu asleep, %lu polls\n", total, asleep, polls);
+	if (!polls)
+		return;
+	fprintf(out, "%.1f awake cycles per poll\n\n", (double)(total - asleep) / polls);
+
+	for (i=0; i<num_symbols; i++)
+		order[i] = i;
+	qsort(order, num_symbols, sizeof(order[0]), byInclusive);
+
+	fprintf(out, "cycles/poll  function (with callees)\n");
+	for (i=0; i<num_symbols && i<SUMMARY_TOP && inclusive[order[i]]; i++)
+		fprintf(out, "%11.1f  %s\n", (double)inclusive[order[i]] / polls, frameName(order[i]));
+}
+
+/******** Simulated SNES controller (4021 shift registers) **********/
+
+static avr_irq_t *snes_data;
+static unsigned short snes_buttons = 0xffff; // Active low, received order
+static unsigned short snes_shift = 0xffff;
+static int snes_latch;
+
+static void snesOutput(void)
+{
+	avr_raise_irq(snes_data, (snes_shift & 0x8000) ? 1 : 0);
+}
+
+static void snesLatchChanged(avr_irq_t *irq, uint32_t value, void *param)
+{
+	snes_latch = value;
+	if (snes_latch) {
+		snes_shift = snes_buttons;
+		snesOutput();
+	}
+}
+
+static void snesClockChanged(avr_irq_t *irq, uint32_t value, void *param)
+{
+	if (value && !snes_latch) {
+		snes_shift <<= 1; // Serial input is grounded on the controller
+		snesOutput();
+	}
+}
+
+static unsigned long rng = 1;
+static unsigned long button_period_us = 50000;
+
+static avr_cycle_count_t snesNewButtons(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	rng = rng * 1103515245 + 12345;
+	// Buttons are in the upper 12 bits, the rest read as 1
+	snes_buttons = ((rng >> 8) & 0xfff0) | 0x000f;
+
+	return when + avr_usec_to_cycles(avr, button_period_us);
+}
+
+/******** Simulated console polling the controller **********/
+
+static avr_irq_t *psx_attention;
+static avr_irq_t *psx_spi_in;
+static unsigned long poll_period_us = 16683; // 59.94Hz
+static unsigned long byte_us = 40; // 32us at 250kHz, plus a gap
+
+static int tx_pos;
+static int tx_len;
+static unsigned char rx[32];
+static unsigned long polls;
+
+static const unsigned char poll_cmd[] = { 0x01, 0x42, 0x00, 0x00, 0x00 };
+
+/* The SPI outputs SPDR as each byte is received (slave mode). The
+ * adapter sends inverted data. */
+static void psxReply(avr_irq_t *irq, uint32_t value, void *param)
+{
+	if (tx_pos < (int)sizeof(rx))
+		rx[tx_pos] = 0xff ^ value;
+}
+
+static avr_cycle_count_t psxByte(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	if (tx_pos == tx_len) {
+		avr_raise_irq(psx_attention, 1);
+		return 0;
+	}
+
+	avr_raise_irq(psx_spi_in, tx_pos < (int)sizeof(poll_cmd) ? poll_cmd[tx_pos] : 0x00);
+	tx_pos++;
+
+	// The ID tells how long the reply is
+	if (tx_pos == 2)
+		tx_len = rx[1] == 0x79 ? 21 : 5;
+
+	return when + avr_usec_to_cycles(avr, byte_us);
+}
+
+static avr_cycle_count_t psxPoll(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	avr_raise_irq(psx_attention, 0);
+	tx_pos = 0;
+	tx_len = 2;
+	polls++;
+	avr_cycle_timer_register_usec(avr, 20, psxByte, NULL);
+
+	return when + avr_usec_to_cycles(avr, poll_period_us);
+}
+
+/******** Main **********/
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [options] firmware.elf symbols.txt\n\n", name);
+	printf("  -m mcu       Microcontroller (default atmega8)\n");
+	printf("  -t seconds   Simulated time (default 3)\n");
+	printf("  -p us        Poll period (default 16683)\n");
+	printf("  -c kHz       Controller port clock (default 250)\n");
+	printf("  -b ms        Button change period (default 50)\n");
+	printf("  -o file      Output file (default stdout)\n");
+}
+
+int main(int argc, char **argv)
+{
+	elf_firmware_t fw;
+	avr_t *avr;
+	const char *mcu = "atmega8";
+	double seconds = 3;
+	FILE *out = stdout;
+	avr_cycle_count_t end;
+	unsigned long long total;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:t:p:c:b:o:h")) != -1) {
+		switch (opt)
+		{
+			case 'm': mcu = optarg; break;
+			case 't': seconds = atof(optarg); break;
+			case 'p': poll_period_us = atol(optarg); break;
+			case 'c': byte_us = 8000 / atol(optarg) + 8; break;
+			case 'b': button_period_us = atol(optarg) * 1000; break;
+			case 'o':
+				out = fopen(optarg, "w");
+				if (!out) {
+					perror(optarg);
+					return 1;
+				}
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (argc - optind != 2) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	memset(&fw, 0, sizeof(fw));
+	if (elf_read_firmware(argv[optind], &fw)) {
+		fprintf(stderr, "Could not load %s\n", argv[optind]);
+		return 1;
+	}
+
+	if (loadSymbols(argv[optind + 1]))
+		return 1;
+
+	avr = avr_make_mcu_by_name(mcu);
+	if (!avr) {
+		fprintf(stderr, "Unknown MCU %s\n", mcu);
+		return 1;
+	}
+	avr_init(avr);
+	avr_load_firmware(avr, &fw);
+	avr->frequency = 8000000;
+
+	// Attention is on PB2 (PB0 and PB1 are shorted to it)
+	psx_attention = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 2);
+	psx_spi_in = avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_INPUT);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_OUTPUT), psxReply, NULL);
+	avr_raise_irq(psx_attention, 1);
+
+	// Latch on PC4, clock on PC5, data on PC3
+	snes_data = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 3);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 4), snesLatchChanged, NULL);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 5), snesClockChanged, NULL);
+	snesOutput();
+
+	avr_cycle_timer_register_usec(avr, 100000, psxPoll, NULL);
+	avr_cycle_timer_register_usec(avr, 100000, snesNewButtons, NULL);
+
+	end = avr->frequency * seconds;
+	while (avr->cycle < end) {
+		if (avr->state == cpu_Done || avr->state == cpu_Crashed) {
+			fprintf(stderr, "Simulation stopped at pc 0x%04x\n", avr->pc);
+			break;
+		}
+		step(avr);
+	}
+
+	printProfile(out, &total);
+	if (out != stdout)
+		fclose(out);
+
+	printSummary(stderr, total, polls);
+
+	return 0;
+}
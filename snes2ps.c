@@ -16,421 +16,45 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
-#include <string.h>
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
-
-#define CMD_BEGIN_01		0x01
-#define CMD_GET_DATA_42		0x42
-#define REP_DATA_START_5A	0x5a
-
-#define DEVICE_ID_DIGITAL_PS1 0x41
-#define DEVICE_ID_DUALSHOCK2  0x79
-
-#define DS2_STICK_CENTERED 0x7F
-#define DS2_ANALOG_BUTTON_PRESSED 0xFF
-#define DS2_ANALOG_BUTTON_UNPRESSED 0x00
-
-
-enum {
-  ST_IDLE = 0,
-  ST_READY,
-  ST_SEND_BUF0,
-  ST_SEND_BUF1,
-  ST_ANALOGSTICKS,
-  ST_ANALOGBUTTONS,
-  ST_DONE
-};
-
-enum {
-  DS2_ANALOG_R = 0,
-  DS2_ANALOG_L,
-  DS2_ANALOG_U,
-  DS2_ANALOG_D,
-  DS2_ANALOG_TRIANGLE,
-  DS2_ANALOG_O,
-  DS2_ANALOG_X,
-  DS2_ANALOG_SQUARE,
-  DS2_ANALOG_L1,
-  DS2_ANALOG_R1,
-  DS2_ANALOG_L2,
-  DS2_ANALOG_R2,
-  MAX_DS2_ANALOG_BUTTONS // Sometimes is used as a throw-away value
-};
-
-/******** IO port definitions **************/
-#define SNES_LATCH_DDR  DDRC
-#define SNES_LATCH_PORT PORTC
-#define SNES_LATCH_BIT  (1<<4)
-
-#define SNES_CLOCK_DDR  DDRC
-#define SNES_CLOCK_PORT PORTC
-#define SNES_CLOCK_BIT  (1<<5)
-
-#define SNES_DATA_PORT  PORTC
-#define SNES_DATA_DDR   DDRC
-#define SNES_DATA_PIN   PINC
-#define SNES_DATA_BIT   (1<<3)
-
-#define PSX_ACK_PORT	PORTC
-#define PSX_ACK_DDR		DDRC
-#define PSX_ACK_PIN		PINC
-#define PSX_ACK_BIT		(1<<0)
-
-/********* IO pins manipulation macros **********/
-#define SNES_LATCH_LOW()    do { SNES_LATCH_PORT &= ~(SNES_LATCH_BIT); } while(0)
-#define SNES_LATCH_HIGH()   do { SNES_LATCH_PORT |= SNES_LATCH_BIT; } while(0)
-#define SNES_CLOCK_LOW()    do { SNES_CLOCK_PORT &= ~(SNES_CLOCK_BIT); } while(0)
-#define SNES_CLOCK_HIGH()   do { SNES_CLOCK_PORT |= SNES_CLOCK_BIT; } while(0)
-
-#define SNES_GET_DATA() (SNES_DATA_PIN & SNES_DATA_BIT)
-
-/*	PSX data : (MSb first)
-		Left    Down  Right  Up    Start  R3  L3  Select
-		Square  X     O      Tri.  R1     L1  R2  L2
-*/
-#define PSX_LEFT		0x8000
-#define PSX_DOWN		0x4000
-#define PSX_RIGHT		0x2000
-#define PSX_UP			0x1000
-#define PSX_START		0x0800
-#define PSX_R3			0x0400
-#define PSX_L3			0x0200
-#define PSX_SELECT		0x0100
-#define PSX_SQUARE		0x0080
-#define PSX_X			0x0040
-#define PSX_O			0x0020
-#define PSX_TRIANGLE	0x0010
-#define PSX_R1			0x0008
-#define PSX_L1			0x0004
-#define PSX_R2			0x0002
-#define PSX_L2			0x0001
-
-/*	SNES data, in the received order.
-		B Y Select Start
-		Up Down Left Right
-		A X L R
-		1 1 1 1
- */
-#define SNES_B		0x8000
-#define SNES_Y		0x4000
-#define SNES_SELECT	0x2000
-#define SNES_START	0x1000
-#define SNES_UP		0x0800
-#define SNES_DOWN	0x0400
-#define SNES_LEFT	0x0200
-#define SNES_RIGHT	0x0100
-#define SNES_A		0x0080
-#define SNES_X		0x0040
-#define SNES_L		0x0020
-#define SNES_R		0x0010
+#include "hal.h"
+#include "snes2ps.h"
+#include "config.h"
+#include "console.h"
+#include "buscfg.h"
+#include "profile.h"
+#include "health.h"
+#include "recorder.h"
+#include "timer.h"
+#include "psx.h"
 
 #define MAPPING_MASK (SNES_START | SNES_SELECT | SNES_A | SNES_B | SNES_X | SNES_Y | SNES_L)
 
-struct map_ent {
-	unsigned short s; // Snes bit
-	unsigned short p; // PSX bit
-  unsigned char analogByte;
-};
-
-static struct map_ent type1_mapping[] = {
-		{ SNES_B, 		PSX_X,        DS2_ANALOG_X },
-		{ SNES_Y, 		PSX_SQUARE,   DS2_ANALOG_SQUARE },
-		{ SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
-		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
-		{ SNES_UP,		PSX_UP,       DS2_ANALOG_U },
-		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
-		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
-		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
-		{ SNES_A,		PSX_O, DS2_ANALOG_O },
-		{ SNES_X,		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
-		{ SNES_R,		PSX_R1, DS2_ANALOG_R1 },
-		{ SNES_L,		PSX_L1, DS2_ANALOG_L1 },
-		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
-};
-
-static struct map_ent type2_mapping[] = {
-		{ SNES_B, 		PSX_O, DS2_ANALOG_O },
-		{ SNES_Y, 		PSX_X, DS2_ANALOG_X },
-    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
-		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
-    { SNES_UP,		PSX_UP,       DS2_ANALOG_U },
-		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
-		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
-		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
-		{ SNES_A,		PSX_R2, DS2_ANALOG_R2 },
-		{ SNES_X,		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
-		{ SNES_R,		PSX_R1, DS2_ANALOG_R1 },
-		{ SNES_L,		PSX_SQUARE,   DS2_ANALOG_SQUARE },
-		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
-};
-
-static struct map_ent type3_mapping[] = {
-		{ SNES_B, 		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
-		{ SNES_Y, 		PSX_O, DS2_ANALOG_O },
-    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
-		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
-    { SNES_UP,		PSX_UP,       DS2_ANALOG_U },
-		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
-		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
-		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
-		{ SNES_A,		PSX_X,   DS2_ANALOG_X },
-		{ SNES_X,		PSX_SQUARE,   DS2_ANALOG_SQUARE },
-		{ SNES_R,		PSX_R1, DS2_ANALOG_R1 },
-		{ SNES_L,		PSX_L1, DS2_ANALOG_L1 },
-		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
-};
-
-static struct map_ent type4_mapping[] = {
-		{ SNES_B, 		PSX_SQUARE,   DS2_ANALOG_SQUARE },
-		{ SNES_Y, 		PSX_X,   DS2_ANALOG_X },
-    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
-		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
-    { SNES_UP,		PSX_UP,       DS2_ANALOG_U },
-		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
-		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
-		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
-		{ SNES_A,		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
-		{ SNES_X,		PSX_O, DS2_ANALOG_O },
-		{ SNES_R,		PSX_R1, DS2_ANALOG_R1 },
-		{ SNES_L,		PSX_L1, DS2_ANALOG_L1 },
-		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
-};
-
-static struct map_ent type5_mapping[] = {
-		{ SNES_B, 		PSX_O, DS2_ANALOG_O },
-		{ SNES_Y, 		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
-    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
-		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
-    { SNES_UP,		PSX_UP,       DS2_ANALOG_U },
-		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
-		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
-		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
-		{ SNES_A,		PSX_SQUARE,   DS2_ANALOG_SQUARE },
-		{ SNES_X,		PSX_X,   DS2_ANALOG_X },
-		{ SNES_R,		PSX_L1, DS2_ANALOG_L1 }, // L/R swapped
-		{ SNES_L,		PSX_R1, DS2_ANALOG_R1 },
-		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
-};
-
-static struct map_ent type6_mapping[] = { // Type 1 with L2/R2
-		{ SNES_B, 		PSX_X,   DS2_ANALOG_X },
-		{ SNES_Y, 		PSX_SQUARE,   DS2_ANALOG_SQUARE },
-    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
-		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
-    { SNES_UP,		PSX_UP,       DS2_ANALOG_U },
-		{ SNES_DOWN,	PSX_DOWN,     DS2_ANALOG_D },
-		{ SNES_LEFT,	PSX_LEFT,     DS2_ANALOG_L },
-		{ SNES_RIGHT,	PSX_RIGHT,    DS2_ANALOG_R },
-		{ SNES_A,		PSX_O, DS2_ANALOG_O },
-		{ SNES_X,		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
-		{ SNES_R,		PSX_R2, DS2_ANALOG_R2 },
-		{ SNES_L,		PSX_L2, DS2_ANALOG_L2 },
-		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
-};
-
-static struct map_ent type7_mapping[] = { // Type 1 with rotated directions for right-hand arcade stick steering
-		{ SNES_B, 		PSX_X,   DS2_ANALOG_X },
-		{ SNES_Y, 		PSX_SQUARE,   DS2_ANALOG_SQUARE },
-    { SNES_SELECT,	PSX_SELECT, MAX_DS2_ANALOG_BUTTONS },
-		{ SNES_START,	PSX_START,    MAX_DS2_ANALOG_BUTTONS },
-		{ SNES_UP,		PSX_DOWN,     DS2_ANALOG_D },
-		{ SNES_DOWN,	PSX_UP,       DS2_ANALOG_U },
-		{ SNES_LEFT,	PSX_RIGHT,    DS2_ANALOG_R },
-		{ SNES_RIGHT,	PSX_LEFT,     DS2_ANALOG_L },
-		{ SNES_A,		PSX_O, DS2_ANALOG_O },
-		{ SNES_X,		PSX_TRIANGLE, DS2_ANALOG_TRIANGLE },
-		{ SNES_R,		PSX_L1, DS2_ANALOG_L1 },
-		{ SNES_L,		PSX_R1, DS2_ANALOG_R1 },
-		{ 0, 0, MAX_DS2_ANALOG_BUTTONS },
-};
-
-static struct map_ent *g_cur_map = type1_mapping;
-static unsigned char state = ST_IDLE;
-static volatile unsigned char psxbuf[2];
-static unsigned char snesbuf[2];
-static unsigned char deviceID = DEVICE_ID_DIGITAL_PS1;
-static unsigned char numStickBytes = 0;
-static unsigned char numButtonBytes = 0;
-static unsigned char psxAnalogButtons[13];
-
-#define CHIP_SELECT_ACTIVE()	(0 == (PINB & (1<<2)))
-
-static void ack()
+#ifdef WITH_HEALTH
+/* Check the controller is there, looks like a pad and reads
+ * consistently. */
+static void selfTest(void)
 {
-	_delay_us(1);
+	unsigned short first;
 
-	// pull acknowledge
-	PSX_ACK_PORT &= ~PSX_ACK_BIT;
-	PSX_ACK_DDR	|= PSX_ACK_BIT;
+	first = snes_read();
+	if ((first & HEALTH_ID_BITS) != HEALTH_ID_BITS)
+		g_health.faults |= HEALTH_BAD_ID;
 
-	_delay_us(3);
+	// The controller shifts in zeros after the 16 button bits. Without
+	// a controller, the pull-up keeps the data line high.
+	_delay_us(6);
+	SNES_CLOCK_LOW();
+	_delay_us(6);
+	if (SNES_GET_DATA())
+		g_health.faults |= HEALTH_NO_PAD;
+	SNES_CLOCK_HIGH();
 
-	// release acknowledge
-	PSX_ACK_DDR &= ~PSX_ACK_BIT;
-}
-
-ISR(SPI_STC_vect)
-{
-	unsigned char cmd;
-
-	cmd = SPDR;
-
-	switch(state)
-	{
-		case ST_IDLE: // Expecting 0x01
-			if (cmd != CMD_BEGIN_01) {
-				/* First byte is no 0x01? This is not a message for us (probably memory card)
-				 *
-				 * Ignore all other bytes until Slave Select is deasserted.
-				 */
-				while (CHIP_SELECT_ACTIVE()) {
-					// Make sure we dont pull the bus low.
-
-					if (SPSR & (1<<SPIF)) {
-						cmd = SPDR;
-						SPDR = 0x00; // dont pull the bus low (sends 0xff)
-					}
-				}
-			}
-			else {
-				// Prepare the Device ID (default is 0x41)
-				SPDR = 0xff ^ deviceID;
-				state = ST_READY;
-				ack();
-			}
-			break;
-
-		case ST_READY: // Expecting 0x42
-			if (cmd == CMD_GET_DATA_42) {
-				SPDR = 0xff ^ REP_DATA_START_5A;
-				state = ST_SEND_BUF0;
-				ack();
-
-			}
-			break;
-
-			// Based on Playstation.txt, I initially understood that the Playstation
-			// would always send 0x00 when reading the button status and wrote code
-			// that checked the received values.
-			//
-			// However, Einhander sends 0x40:
-			//  Game...: 0x01, 0x42, 0x00, 0x40,   0x00
-			//  Adapter: 0xFF, 0x41, 0x5a, dat[0], dat[1]
-			//
-			// And rollcage sends a 0x01:
-			//  Game...: 0x01, 0x42, 0x01, 0x00,   0x00
-			//  Adapter: 0xFF, 0x41, 0x5a, dat[0], dat[1]
-			//
-			// The unexpected values above prevented the games from working, so
-			// I now treat the transmitted values during button status as "don't care"
-			// rather than "expecting 0".
-			//
-			// This seems to be working well.
-			//
-		case ST_SEND_BUF0: // start of data 0x5a sent
-				SPDR = 0xff ^ psxbuf[0];
-				state = ST_SEND_BUF1;
-				ack();
-				break;
-
-		case ST_SEND_BUF1: // psxbuf[0] sent
-				SPDR = 0xff ^ psxbuf[1];
-        if (deviceID == DEVICE_ID_DUALSHOCK2) state = ST_ANALOGSTICKS;
-        else state = ST_DONE;
-				ack();
-				break;
-
-    case ST_ANALOGSTICKS: // psxbuf[1] sent, faking DualShock 2 sticks
-				SPDR = 0xFF ^ DS2_STICK_CENTERED; // Sends 0x7F (default value for DS2 sticks)
-        numStickBytes--;
-        ack();
-        while (numStickBytes) {
-          if (SPSR & (1<<SPIF)) {
-            numStickBytes--;
-            SPDR = 0xFF ^ DS2_STICK_CENTERED; // Send another 0x7F
-            ack();
-          }
-        }
-        state = ST_ANALOGBUTTONS;
-				break;
-
-    case ST_ANALOGBUTTONS: // Fake stick data sent, faking DualShock 2 analog buttons by sending either 0x00 or 0xFF
-				SPDR = 0xFF ^ psxAnalogButtons[0];
-        numButtonBytes++;
-        ack();
-        while (numButtonBytes < 12) {
-          if (SPSR & (1<<SPIF)) {
-            SPDR = 0xFF ^ psxAnalogButtons[numButtonBytes];
-            numButtonBytes++;
-            ack();
-          }
-        }
-        state = ST_DONE;
-				break;
-
-		case ST_DONE: // All data sent
-				SPDR = 0x00; // dont pull the bus low (send 0xff)
-				state = ST_IDLE;
-				break;
-	}
+	if (first != snes_read())
+		g_health.faults |= HEALTH_UNSTABLE;
 
+	health_report();
 }
-
-/* update snesbuf[] */
-static void snesUpdate(void)
-{
-	int i,j;
-	unsigned char tmp=0;
-
-	SNES_LATCH_HIGH();
-	_delay_us(12);
-	SNES_LATCH_LOW();
-
-	for (j=0; j<2; j++)
-	{
-		for (i=0; i<8; i++)
-		{
-			_delay_us(6);
-			SNES_CLOCK_LOW();
-
-			tmp <<= 1;
-			if (SNES_GET_DATA())
-				tmp |= 1;
-
-			_delay_us(6);
-
-			SNES_CLOCK_HIGH();
-		}
-		snesbuf[j] = tmp;
-	}
-
-}
-
-unsigned short snes2psx(unsigned short snesbits)
-{
-	unsigned short psxval;
-	int i;
-	struct map_ent *map = g_cur_map;
-
-	/* Start with a ALL ones message and
-	 * clear the bits when needed. */
-	psxval = 0xffff;
-
-	for (i=0; map[i].s; i++) {
-		if (!(snesbits & map[i].s)) {
-			psxval &= ~(map[i].p);
-      psxAnalogButtons[map[i].analogByte] = DS2_ANALOG_BUTTON_PRESSED;
-    }
-    else
-    {
-      psxAnalogButtons[map[i].analogByte] = DS2_ANALOG_BUTTON_UNPRESSED;
-    }
-	}
-
-	return psxval;
-}
+#endif
 
 int main(void)
 {
@@ -464,13 +88,13 @@ int main(void)
 	/* PORTD
 	 *
 	 *    Name         Type
-	 * 0: USB          OUT 0
-	 * 1: USB          OUT 0
+	 * 0: RXD          Console (see console.h)
+	 * 1: TXD          Console
 	 * 2: USB          OUT 0
 	 * 3: NC           OUT 0
 	 * 4: VCC          OUT 1
 	 * 5: NC           OUT 1
-	 * 6: NC           OUT 1
+	 * 6: Fault LED    OUT 0 when a self test fault is found (health.h)
 	 * 7: NC           OUT 1
 	 *
 	 */
@@ -494,10 +118,6 @@ int main(void)
 	PSX_ACK_PORT &= ~PSX_ACK_BIT;
 	PSX_ACK_DDR &= ~PSX_ACK_BIT;
 
-	// buttons are active low and reserved bits stay high.
-	psxbuf[0] = 0xff;
-	psxbuf[1] = 0xff;
-
 	// TODO: Snes stuff
 	//
 	// clock and latch as output
@@ -516,56 +136,80 @@ int main(void)
 	// LATCH is Active HIGH
 	SNES_LATCH_PORT &= ~(SNES_LATCH_BIT);
 
-	snesUpdate();
+	unsigned short snesbits = 0xFFFF ^ snes_read();
+
+	// Settings saved from the console are the default. Boot chords
+	// still override them.
+	if (config_load()) {
+		config_usePreset(1);
+	}
 
-  unsigned short snesbits = 0xFFFF ^ (snesbuf[0]<<8 | snesbuf[1]);
 	switch (snesbits & MAPPING_MASK)
 	{
 		case SNES_START:
-			g_cur_map = type1_mapping;
+			config_usePreset(1);
 			break;
 		case SNES_SELECT:
-			g_cur_map = type2_mapping;
+			config_usePreset(2);
 			break;
 		case SNES_A:
-			g_cur_map = type3_mapping;
+			config_usePreset(3);
 			break;
 		case SNES_B:
-			g_cur_map = type4_mapping;
+			config_usePreset(4);
 			break;
 		case SNES_X:
-			g_cur_map = type5_mapping;
+			config_usePreset(5);
 			break;
 		case SNES_Y:
-			g_cur_map = type6_mapping;
+			config_usePreset(6);
 			break;
 		case SNES_L:
-			g_cur_map = type7_mapping;
+			config_usePreset(7);
 			break;
 	}
   if (snesbits & SNES_UP)
   {
-    deviceID = DEVICE_ID_DUALSHOCK2;
+    g_cfg.deviceID = DEVICE_ID_DUALSHOCK2;
   }
-  memset(psxAnalogButtons, DS2_ANALOG_BUTTON_UNPRESSED, 12);
+#ifdef WITH_HEALTH
+	selfTest();
+#endif
+	psx_init();
+	recorder_init();
+	timer_init();
+
+	/* Attention going high (PB0 is ICP1) ends a transaction, see
+	 * HAL_PSX_ATTN_HANDLER(). Only the capture flag is used, with the
+	 * noise canceler on. */
+	TCCR1A = 0;
+	TCCR1B = (1<<ICNC1) | (1<<ICES1) | (1<<CS10);
+#ifdef TIMSK1
+	TIFR1 = (1<<ICF1);
+	TIMSK1 = (1<<ICIE1);
+#else
+	TIFR = (1<<ICF1);
+	TIMSK |= (1<<TICIE1);
+#endif
+
+	console_init();
+	buscfg_init();
+	// A boot chord means the user chose, don't second-guess it.
+	profile_init(!(snesbits & (MAPPING_MASK | SNES_UP)));
 
 	sei();
 	while(1)
 	{
-		unsigned short psxbits;
-
-		if (!CHIP_SELECT_ACTIVE()) {
-			SPDR = 0x00;
-			state = ST_IDLE;
-      numStickBytes = 4;
-      numButtonBytes = 0;
-		}
-
-		snesUpdate();
+		unsigned short buttons;
 
-		psxbits = snes2psx((snesbuf[0]<<8) | snesbuf[1]);
+		// Every pass, so the buttons sent are as fresh as the loop allows
+		buttons = psx_poll();
 
-		psxbuf[0] = psxbits >> 8;
-		psxbuf[1] = psxbits & 0xff;
+		console_poll();
+		buscfg_poll();
+		config_poll();
+		profile_poll();
+		health_poll();
+		recorder_poll(buttons);
 	}
 }
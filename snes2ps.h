@@ -0,0 +1,94 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _snes2ps_h__
+#define _snes2ps_h__
+
+#define DEVICE_ID_DIGITAL_PS1 0x41
+#define DEVICE_ID_DUALSHOCK2  0x79
+
+#define DS2_STICK_CENTERED 0x7F
+#define DS2_ANALOG_BUTTON_PRESSED 0xFF
+#define DS2_ANALOG_BUTTON_UNPRESSED 0x00
+
+enum {
+  DS2_ANALOG_R = 0,
+  DS2_ANALOG_L,
+  DS2_ANALOG_U,
+  DS2_ANALOG_D,
+  DS2_ANALOG_TRIANGLE,
+  DS2_ANALOG_O,
+  DS2_ANALOG_X,
+  DS2_ANALOG_SQUARE,
+  DS2_ANALOG_L1,
+  DS2_ANALOG_R1,
+  DS2_ANALOG_L2,
+  DS2_ANALOG_R2,
+  MAX_DS2_ANALOG_BUTTONS // Sometimes is used as a throw-away value
+};
+
+/*	PSX data : (MSb first)
+		Left    Down  Right  Up    Start  R3  L3  Select
+		Square  X     O      Tri.  R1     L1  R2  L2
+*/
+#define PSX_LEFT		0x8000
+#define PSX_DOWN		0x4000
+#define PSX_RIGHT		0x2000
+#define PSX_UP			0x1000
+#define PSX_START		0x0800
+#define PSX_R3			0x0400
+#define PSX_L3			0x0200
+#define PSX_SELECT		0x0100
+#define PSX_SQUARE		0x0080
+#define PSX_X			0x0040
+#define PSX_O			0x0020
+#define PSX_TRIANGLE	0x0010
+#define PSX_R1			0x0008
+#define PSX_L1			0x0004
+#define PSX_R2			0x0002
+#define PSX_L2			0x0001
+
+/*	SNES data, in the received order.
+		B Y Select Start
+		Up Down Left Right
+		A X L R
+		1 1 1 1
+ */
+#define SNES_B		0x8000
+#define SNES_Y		0x4000
+#define SNES_SELECT	0x2000
+#define SNES_START	0x1000
+#define SNES_UP		0x0800
+#define SNES_DOWN	0x0400
+#define SNES_LEFT	0x0200
+#define SNES_RIGHT	0x0100
+#define SNES_A		0x0080
+#define SNES_X		0x0040
+#define SNES_L		0x0020
+#define SNES_R		0x0010
+
+/* Statistics maintained by the PSX interrupt handler. Multi-byte
+ * values must be read with interrupts disabled. */
+struct psx_counters {
+	unsigned short polls;	// Transactions addressed to us (0x01 received)
+	unsigned short ignored;	// Transactions for someone else (memory card)
+};
+
+extern volatile struct psx_counters g_counters;
+
+#endif // _snes2ps_h__
@@ -0,0 +1,67 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "timer.h"
+
+/* Clear on compare match at clk/64 */
+#define TIMER_OCR	(F_CPU / 64 / 1000 - 1)
+
+#if TIMER_OCR > 255
+#error F_CPU too high for Timer2 at clk/64
+#endif
+
+/* The Atmega168 has two compare units on Timer2, the Atmega8 one. */
+#ifdef TIMER2_COMPA_vect
+#define TIMER_vect	TIMER2_COMPA_vect
+#else
+#define TIMER_vect	TIMER2_COMP_vect
+#endif
+
+static volatile unsigned short ms;
+
+ISR(TIMER_vect)
+{
+	ms++;
+}
+
+void timer_init(void)
+{
+#ifdef TIMSK2
+	TCCR2A = (1<<WGM21);
+	TCCR2B = (1<<CS22);
+	OCR2A = TIMER_OCR;
+	TIMSK2 = (1<<OCIE2A);
+#else
+	TCCR2 = (1<<WGM21) | (1<<CS22);
+	OCR2 = TIMER_OCR;
+	TIMSK |= (1<<OCIE2);
+#endif
+}
+
+unsigned short timer_ms(void)
+{
+	unsigned short t;
+
+	cli();
+	t = ms;
+	sei();
+
+	return t;
+}
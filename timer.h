@@ -0,0 +1,30 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _timer_h__
+#define _timer_h__
+
+/* Millisecond time base on Timer2, for timeouts and periodic work in the
+ * main loop. The interrupt is a few cycles every millisecond. */
+void timer_init(void);
+
+/* Milliseconds since timer_init(). Wraps every 65.5 seconds, so compare
+ * differences: (unsigned short)(timer_ms() - start) >= timeout. */
+unsigned short timer_ms(void);
+
+#endif // _timer_h__
@@ -0,0 +1,142 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "uart.h"
+
+/* The Atmega8 and Atmega168 have the same USART, but the 168 numbers
+ * its registers and bits. */
+#ifdef UDR0
+#define UART_UDR	UDR0
+#define UART_UCSRA	UCSR0A
+#define UART_UCSRB	UCSR0B
+#define UART_UBRRL	UBRR0L
+#define UART_U2X	U2X0
+#define UART_RXEN	RXEN0
+#define UART_TXEN	TXEN0
+#define UART_RXCIE	RXCIE0
+#define UART_UDRIE	UDRIE0
+#else
+#define UART_UDR	UDR
+#define UART_UCSRA	UCSRA
+#define UART_UCSRB	UCSRB
+#define UART_UBRRL	UBRRL
+#define UART_U2X	U2X
+#define UART_RXEN	RXEN
+#define UART_TXEN	TXEN
+#define UART_RXCIE	RXCIE
+#define UART_UDRIE	UDRIE
+#endif
+
+#ifdef USART_RX_vect
+#define UART_RX_vect	USART_RX_vect
+#else
+#define UART_RX_vect	USART_RXC_vect
+#endif
+
+#if UART_RX_SIZE & (UART_RX_SIZE - 1)
+#error UART_RX_SIZE must be a power of 2
+#endif
+
+#if UART_TX_SIZE & (UART_TX_SIZE - 1)
+#error UART_TX_SIZE must be a power of 2
+#endif
+
+/* Double speed mode gives 0.2% error at 38400 from 8MHz */
+#define UART_UBRR_VALUE	((F_CPU / 8 / UART_BAUD) - 1)
+
+#if UART_UBRR_VALUE > 255
+#error UART_BAUD too low for this F_CPU
+#endif
+
+static volatile unsigned char rx_buf[UART_RX_SIZE];
+static volatile unsigned char rx_head;
+static unsigned char rx_tail;
+
+static unsigned char tx_buf[UART_TX_SIZE];
+static unsigned char tx_head;
+static volatile unsigned char tx_tail;
+
+/* The PSX interrupt handler keeps the main loop away for up to a
+ * DualShock 2 transaction, longer than the 2 byte FIFO lasts. */
+ISR(UART_RX_vect)
+{
+	unsigned char c = UART_UDR;
+	unsigned char next = (rx_head + 1) & (UART_RX_SIZE - 1);
+
+	// When full, the byte is dropped and the console resyncs
+	if (next != rx_tail) {
+		rx_buf[rx_head] = c;
+		rx_head = next;
+	}
+}
+
+/* A few cycles per byte sent, instead of the main loop waiting about
+ * 260us for each. */
+ISR(USART_UDRE_vect)
+{
+	unsigned char tail = tx_tail;
+
+	UART_UDR = tx_buf[tail];
+	tail = (tail + 1) & (UART_TX_SIZE - 1);
+	tx_tail = tail;
+
+	if (tail == tx_head)
+		UART_UCSRB &= ~(1<<UART_UDRIE);
+}
+
+void uart_init(void)
+{
+	/* UBRRH is left at 0 (on the Atmega8 it shares its address
+	 * with UCSRC, which already defaults to 8N1 on both chips) */
+	UART_UBRRL = UART_UBRR_VALUE;
+	UART_UCSRA = (1<<UART_U2X);
+	UART_UCSRB = (1<<UART_RXCIE) | (1<<UART_RXEN) | (1<<UART_TXEN);
+}
+
+int uart_getc(void)
+{
+	unsigned char c;
+
+	if (rx_tail == rx_head)
+		return -1;
+
+	c = rx_buf[rx_tail];
+	rx_tail = (rx_tail + 1) & (UART_RX_SIZE - 1);
+
+	return c;
+}
+
+void uart_putc(unsigned char c)
+{
+	unsigned char next = (tx_head + 1) & (UART_TX_SIZE - 1);
+
+	while (next == tx_tail) { }
+
+	tx_buf[tx_head] = c;
+	tx_head = next;
+
+	// The interrupt disables itself once the buffer is empty
+	UART_UCSRB |= (1<<UART_UDRIE);
+}
+
+unsigned char uart_txBusy(void)
+{
+	return tx_head != tx_tail;
+}
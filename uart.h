@@ -0,0 +1,49 @@
+/*
+    snes2psx: SNES controller to Playstation adapter
+    Copyright (C) 2012-2014 Raphael Assenat <raph@raphnet.net>
+    Modified 2020 Jeff Stenhouse
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _uart_h__
+#define _uart_h__
+
+#ifndef UART_BAUD
+#define UART_BAUD	38400
+#endif
+
+/* Received bytes are buffered by the RX interrupt */
+#ifndef UART_RX_SIZE
+#define UART_RX_SIZE	16
+#endif
+
+/* Bytes to send are buffered and sent by the UDRE interrupt, so a whole
+ * reply can be queued without waiting. */
+#ifndef UART_TX_SIZE
+#define UART_TX_SIZE	128
+#endif
+
+/* 8N1. Takes over PD0 (RXD) and PD1 (TXD). */
+void uart_init(void);
+
+/* Returns -1 when no byte is waiting. */
+int uart_getc(void);
+
+/* Blocks until the byte fits in the transmit buffer. */
+void uart_putc(unsigned char c);
+
+/* Non-zero while queued bytes are not all sent. */
+unsigned char uart_txBusy(void);
+
+#endif // _uart_h__